@@ -0,0 +1,514 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+
+struct MidiEvent {
+  enum class Type {
+    NoteOff,
+    NoteOn,
+    Other
+  } event;
+
+  uint8_t nKey = 0;
+  uint8_t nVelocity = 0;
+  uint32_t nDeltaTick = 0;
+  uint8_t nChannel = 0;
+};
+
+struct MidiNote {
+  uint8_t nKey = 0;
+  uint8_t nVelocity = 0;
+  uint8_t nChannel = 0;
+  uint32_t nStartTime = 0;
+  uint32_t nDuration = 0;
+};
+
+struct MidiTempo {
+  uint32_t nTick = 0;
+  uint32_t nTempo = 500000; // Microseconds per quarter note
+  double dSeconds = 0.0; // Song time at nTick, filled in once parsing is done
+};
+
+struct MidiTrack {
+  std::string sName;
+  std::string sInstrument;
+  std::vector < MidiEvent > vecEvents;
+  std::vector < MidiNote > vecNotes;
+  uint8_t nMaxNote = 64;
+  uint8_t nMinNote = 64;
+  uint32_t nMaxDuration = 0; // Longest note, bounds how far back a visible note can start
+};
+
+class MidiFile {
+  public: enum EventName: uint8_t {
+    VoiceNoteOff = 0x80,
+      VoiceNoteOn = 0x90,
+      VoiceAftertouch = 0xA0,
+      VoiceControlChange = 0xB0,
+      VoiceProgramChange = 0xC0,
+      VoiceChannelPressure = 0xD0,
+      VoicePitchBend = 0xE0,
+      SystemExclusive = 0xF0,
+  };
+
+  enum MetaEventName: uint8_t {
+    MetaSequence = 0x00,
+      MetaText = 0x01,
+      MetaCopyright = 0x02,
+      MetaTrackName = 0x03,
+      MetaInstrumentName = 0x04,
+      MetaLyrics = 0x05,
+      MetaMarker = 0x06,
+      MetaCuePoint = 0x07,
+      MetaChannelPrefix = 0x20,
+      MetaEndOfTrack = 0x2F,
+      MetaSetTempo = 0x51,
+      MetaSMPTEOffset = 0x54,
+      MetaTimeSignature = 0x58,
+      MetaKeySignature = 0x59,
+      MetaSequencerSpecific = 0x7F,
+  };
+
+  public: MidiFile() {}
+
+  MidiFile(const std::string & sFileName) {
+    ParseFile(sFileName);
+  }
+
+  void Clear() {
+    vecTracks.clear();
+    vecTempo.clear();
+    m_nTempo = 0;
+    m_nBPM = 0;
+    m_nDivision = 0;
+  }
+
+  bool ParseFile(const std::string & sFileName) {
+    std::ifstream ifs;
+    ifs.open(sFileName, std::fstream::in | std::ios::binary);
+    if (!ifs.is_open())
+      return false;
+    return Parse(ifs);
+  }
+
+  // Parses a complete MIDI file from any seekable binary stream
+  bool Parse(std::istream & ifs) {
+    Clear();
+
+    // Diagnostics go to std::cout unless bVerbose is off, in which case the
+    // stream has no buffer and silently swallows everything
+    std::ostream log(bVerbose ? std::cout.rdbuf() : nullptr);
+
+    auto Swap32 = [](uint32_t n) {
+      return (((n >> 24) & 0xff) | ((n << 8) & 0xff0000) | ((n >> 8) & 0xff00) | ((n << 24) & 0xff000000));
+    };
+
+    auto Swap16 = [](uint16_t n) {
+      return ((n >> 8) | (n << 8));
+    };
+
+    auto ReadString = [ & ifs](uint32_t nLength) {
+      std::string s;
+      for (uint32_t i = 0; i < nLength; i++) s += ifs.get();
+      return s;
+    };
+
+    auto ReadValue = [ & ifs]() {
+      uint32_t nValue = 0;
+      uint8_t nByte = 0;
+
+      nValue = ifs.get();
+
+      if (nValue & 0x80) {
+
+        nValue &= 0x7F;
+        do {
+          nByte = ifs.get();
+          nValue = (nValue << 7) | (nByte & 0x7F);
+        }
+        while (nByte & 0x80); // Loop whilst read byte MSB is 1
+      }
+
+      // Return final construction (always 32-bit unsigned integer internally)
+      return nValue;
+    };
+
+    uint32_t n32 = 0;
+    uint16_t n16 = 0;
+
+    // Read MIDI Header (Fixed Size)
+    ifs.read((char * ) & n32, sizeof(uint32_t));
+    uint32_t nFileID = Swap32(n32);
+    ifs.read((char * ) & n32, sizeof(uint32_t));
+    uint32_t nHeaderLength = Swap32(n32);
+    ifs.read((char * ) & n16, sizeof(uint16_t));
+    uint16_t nFormat = Swap16(n16);
+    ifs.read((char * ) & n16, sizeof(uint16_t));
+    uint16_t nTrackChunks = Swap16(n16);
+    ifs.read((char * ) & n16, sizeof(uint16_t));
+    uint16_t nDivision = Swap16(n16);
+    m_nDivision = nDivision;
+    if (IsSMPTE())
+      log << "SMPTE division: " << -int(int8_t(nDivision >> 8)) << " frames/s, " << (nDivision & 0xFF) << " ticks/frame" << std::endl;
+
+    for (uint16_t nChunk = 0; nChunk < nTrackChunks; nChunk++) {
+      log << "===== NEW TRACK" << std::endl;
+      // Read Track Header
+      ifs.read((char * ) & n32, sizeof(uint32_t));
+      uint32_t nTrackID = Swap32(n32);
+      ifs.read((char * ) & n32, sizeof(uint32_t));
+      uint32_t nTrackLength = Swap32(n32);
+
+      bool bEndOfTrack = false;
+
+      vecTracks.push_back(MidiTrack());
+
+      uint32_t nWallTime = 0;
+
+      uint8_t nPreviousStatus = 0;
+
+      while (!ifs.eof() && !bEndOfTrack) {
+        if (pCancel && pCancel -> load(std::memory_order_relaxed)) return false;
+
+        // Fundamentally all MIDI Events contain a timecode, and a status byte*
+        uint32_t nStatusTimeDelta = 0;
+        uint8_t nStatus = 0;
+
+        // Read Timecode from MIDI stream. This could be variable in length
+        // and is the delta in "ticks" from the previous event. Of course this value
+        // could be 0 if two events happen simultaneously.
+        nStatusTimeDelta = ReadValue();
+        nWallTime += nStatusTimeDelta;
+
+        // Read first byte of message, this could be the status byte, or it could not...
+        nStatus = ifs.get();
+
+        // All MIDI Status events have the MSB set. The data within a standard MIDI event
+        // does not. A crude yet utilised form of compression is to omit sending status
+        // bytes if the following sequence of events all refer to the same MIDI Status.
+        // This is called MIDI Running Status, and is essential to succesful decoding of
+        // MIDI streams and files.
+        //
+        // If the MSB of the read byte was not set, and on the whole we were expecting a
+        // status byte, then Running Status is in effect, so we refer to the previous 
+        // confirmed status byte.
+        if (nStatus < 0x80) {
+          // MIDI Running Status is happening, so refer to previous valid MIDI Status byte
+          nStatus = nPreviousStatus;
+
+          // We had to read the byte to assess if MIDI Running Status is in effect. But!
+          // that read removed the byte form the stream, and that will desync all of the 
+          // following code because normally we would have read a status byte, but instead
+          // we have read the data contained within a MIDI message. The simple solution is 
+          // to put the byte back :P
+          ifs.seekg(-1, std::ios_base::cur);
+        }
+
+        if ((nStatus & 0xF0) == EventName::VoiceNoteOff) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nNoteID = ifs.get();
+          uint8_t nNoteVelocity = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::NoteOff,
+            nNoteID,
+            nNoteVelocity,
+            nStatusTimeDelta,
+            nChannel
+          });
+        } else if ((nStatus & 0xF0) == EventName::VoiceNoteOn) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nNoteID = ifs.get();
+          uint8_t nNoteVelocity = ifs.get();
+          if (nNoteVelocity == 0)
+            vecTracks[nChunk].vecEvents.push_back({
+              MidiEvent::Type::NoteOff,
+              nNoteID,
+              nNoteVelocity,
+              nStatusTimeDelta,
+              nChannel
+            });
+          else
+            vecTracks[nChunk].vecEvents.push_back({
+              MidiEvent::Type::NoteOn,
+              nNoteID,
+              nNoteVelocity,
+              nStatusTimeDelta,
+              nChannel
+            });
+        } else if ((nStatus & 0xF0) == EventName::VoiceAftertouch) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nNoteID = ifs.get();
+          uint8_t nNoteVelocity = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::Other
+          });
+        } else if ((nStatus & 0xF0) == EventName::VoiceControlChange) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nControlID = ifs.get();
+          uint8_t nControlValue = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::Other
+          });
+        } else if ((nStatus & 0xF0) == EventName::VoiceProgramChange) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nProgramID = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::Other
+          });
+        } else if ((nStatus & 0xF0) == EventName::VoiceChannelPressure) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nChannelPressure = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::Other
+          });
+        } else if ((nStatus & 0xF0) == EventName::VoicePitchBend) {
+          nPreviousStatus = nStatus;
+          uint8_t nChannel = nStatus & 0x0F;
+          uint8_t nLS7B = ifs.get();
+          uint8_t nMS7B = ifs.get();
+          vecTracks[nChunk].vecEvents.push_back({
+            MidiEvent::Type::Other
+          });
+
+        } else if ((nStatus & 0xF0) == EventName::SystemExclusive) {
+          nPreviousStatus = 0;
+
+          if (nStatus == 0xFF) {
+            // Meta Message
+            uint8_t nType = ifs.get();
+            uint8_t nLength = ReadValue();
+
+            switch (nType) {
+            case MetaSequence:
+              log << "Sequence Number: " << ifs.get() << ifs.get() << std::endl;
+              break;
+            case MetaText:
+              log << "Text: " << ReadString(nLength) << std::endl;
+              break;
+            case MetaCopyright:
+              log << "Copyright: " << ReadString(nLength) << std::endl;
+              break;
+            case MetaTrackName:
+              vecTracks[nChunk].sName = ReadString(nLength);
+              log << "Track Name: " << vecTracks[nChunk].sName << std::endl;
+              break;
+            case MetaInstrumentName:
+              vecTracks[nChunk].sInstrument = ReadString(nLength);
+              log << "Instrument Name: " << vecTracks[nChunk].sInstrument << std::endl;
+              break;
+            case MetaLyrics:
+              log << "Lyrics: " << ReadString(nLength) << std::endl;
+              break;
+            case MetaMarker:
+              log << "Marker: " << ReadString(nLength) << std::endl;
+              break;
+            case MetaCuePoint:
+              log << "Cue: " << ReadString(nLength) << std::endl;
+              break;
+            case MetaChannelPrefix:
+              log << "Prefix: " << ifs.get() << std::endl;
+              break;
+            case MetaEndOfTrack:
+              bEndOfTrack = true;
+              break;
+            case MetaSetTempo:
+              // Tempo is in microseconds per quarter note	
+              {
+                // Always consume the payload, even though only the first tempo is kept
+                uint32_t nTempo = 0;
+                (nTempo |= (ifs.get() << 16));
+                (nTempo |= (ifs.get() << 8));
+                (nTempo |= (ifs.get() << 0));
+                if (nTempo != 0) vecTempo.push_back({
+                  nWallTime,
+                  nTempo
+                });
+                if (m_nTempo == 0 && nTempo != 0) {
+                  m_nTempo = nTempo;
+                  m_nBPM = (60000000 / m_nTempo);
+                  log << "Tempo: " << m_nTempo << " (" << m_nBPM << "bpm)" << std::endl;
+                }
+              }
+              break;
+            case MetaSMPTEOffset:
+              log << "SMPTE: H:" << ifs.get() << " M:" << ifs.get() << " S:" << ifs.get() << " FR:" << ifs.get() << " FF:" << ifs.get() << std::endl;
+              break;
+            case MetaTimeSignature:
+              log << "Time Signature: " << ifs.get() << "/" << (2 << ifs.get()) << std::endl;
+              log << "ClocksPerTick: " << ifs.get() << std::endl;
+
+              // A MIDI "Beat" is 24 ticks, so specify how many 32nd notes constitute a beat
+              log << "32per24Clocks: " << ifs.get() << std::endl;
+              break;
+            case MetaKeySignature:
+              log << "Key Signature: " << ifs.get() << std::endl;
+              log << "Minor Key: " << ifs.get() << std::endl;
+              break;
+            case MetaSequencerSpecific:
+              log << "Sequencer Specific: " << ReadString(nLength) << std::endl;
+              break;
+            default:
+              log << "Unrecognised MetaEvent: " << nType << std::endl;
+              ReadString(nLength);
+            }
+          }
+
+          if (nStatus == 0xF0) {
+            // System Exclusive Message Begin
+            log << "System Exclusive Begin: " << ReadString(ReadValue()) << std::endl;
+          }
+
+          if (nStatus == 0xF7) {
+            // System Exclusive Message Begin
+            log << "System Exclusive End: " << ReadString(ReadValue()) << std::endl;
+          }
+        } else {
+          log << "Unrecognised Status Byte: " << nStatus << std::endl;
+        }
+      }
+
+      BuildNotes(vecTracks[nChunk]);
+      if (OnTrackParsed && !OnTrackParsed( * this, nChunk)) return false;
+    }
+
+    BuildTempoMap();
+    return true;
+  }
+
+  // Pairs up a track's note on and off events into notes
+  void BuildNotes(MidiTrack & track) {
+    uint32_t nWallTime = 0;
+
+    std::list < MidiNote > listNotesBeingProcessed;
+
+    for (auto & event: track.vecEvents) {
+      nWallTime += event.nDeltaTick;
+
+      if (event.event == MidiEvent::Type::NoteOn) {
+        // New Note
+        listNotesBeingProcessed.push_back({
+          event.nKey,
+          event.nVelocity,
+          event.nChannel,
+          nWallTime,
+          0
+        });
+      }
+
+      if (event.event == MidiEvent::Type::NoteOff) {
+        auto note = std::find_if(listNotesBeingProcessed.begin(), listNotesBeingProcessed.end(), [ & ](const MidiNote & n) {
+          return n.nKey == event.nKey && n.nChannel == event.nChannel;
+        });
+        if (note != listNotesBeingProcessed.end()) {
+          note -> nDuration = nWallTime - note -> nStartTime;
+          track.vecNotes.push_back( * note);
+          track.nMinNote = std::min(track.nMinNote, note -> nKey);
+          track.nMaxNote = std::max(track.nMaxNote, note -> nKey);
+          track.nMaxDuration = std::max(track.nMaxDuration, note -> nDuration);
+          listNotesBeingProcessed.erase(note);
+        }
+      }
+    }
+
+    // Notes complete in note-off order, keep them sorted by start so
+    // time windows can be found with a binary search
+    std::stable_sort(track.vecNotes.begin(), track.vecNotes.end(), [](const MidiNote & a,
+      const MidiNote & b) {
+      return a.nStartTime < b.nStartTime;
+    });
+  }
+
+  /* Orders the tempo changes and accumulates the song time at each. Tempo
+   * changes can live in any track, and before the first the tempo is the
+   * default 120bpm. Done once every track has been read.
+   */
+  void BuildTempoMap() {
+    std::stable_sort(vecTempo.begin(), vecTempo.end(), [](const MidiTempo & a,
+      const MidiTempo & b) {
+      return a.nTick < b.nTick;
+    });
+    if (vecTempo.empty() || vecTempo.front().nTick != 0)
+      vecTempo.insert(vecTempo.begin(), MidiTempo());
+    for (size_t i = 1; i < vecTempo.size(); i++)
+      vecTempo[i].dSeconds = vecTempo[i - 1].dSeconds + double(vecTempo[i].nTick - vecTempo[i - 1].nTick) * TickSeconds(vecTempo[i - 1].nTempo);
+  }
+
+  // With the top bit of the division set, ticks are fixed fractions of a
+  // second: the high byte is minus the SMPTE frame rate (-29 meaning 29.97)
+  // and the low byte is ticks per frame. Tempo events then do not change
+  // the time a tick takes.
+  bool IsSMPTE() const {
+    return (m_nDivision & 0x8000) != 0;
+  }
+
+  // Length of one tick in seconds at the given tempo (us per quarter note)
+  double TickSeconds(uint32_t nTempo) const {
+    if (IsSMPTE()) {
+      int nFPS = -int(int8_t(m_nDivision >> 8));
+      double dFPS = nFPS == 29 ? 30000.0 / 1001.0 : double(std::max(1, nFPS));
+      return 1.0 / (dFPS * std::max(1, m_nDivision & 0xFF));
+    }
+    return nTempo * 1.0e-6 / std::max(1, int(m_nDivision));
+  }
+
+  // Length of the song in seconds, up to the end of its last note
+  double Duration() const {
+    uint64_t nEnd = 0;
+    for (auto & track: vecTracks)
+      for (auto & note: track.vecNotes) nEnd = std::max < uint64_t > (nEnd, uint64_t(note.nStartTime) + note.nDuration);
+    return TickToSeconds(double(nEnd));
+  }
+
+  // Conversions between ticks and seconds through the tempo map, O(log n)
+  // in the number of tempo changes
+  double TickToSeconds(double dTick) const {
+    if (vecTempo.empty()) return 0.0;
+    auto it = std::upper_bound(vecTempo.begin(), vecTempo.end(), dTick, [](double t,
+      const MidiTempo & tempo) {
+      return t < double(tempo.nTick);
+    });
+    const MidiTempo & tempo = it == vecTempo.begin() ? * it : * (it - 1);
+    return tempo.dSeconds + (dTick - tempo.nTick) * TickSeconds(tempo.nTempo);
+  }
+
+  double SecondsToTick(double dSeconds) const {
+    if (vecTempo.empty()) return 0.0;
+    auto it = std::upper_bound(vecTempo.begin(), vecTempo.end(), dSeconds, [](double s,
+      const MidiTempo & tempo) {
+      return s < tempo.dSeconds;
+    });
+    const MidiTempo & tempo = it == vecTempo.begin() ? * it : * (it - 1);
+    return tempo.nTick + (dSeconds - tempo.dSeconds) / TickSeconds(tempo.nTempo);
+  }
+
+  public: std::vector < MidiTrack > vecTracks;
+  std::vector < MidiTempo > vecTempo;
+  uint32_t m_nTempo = 0;
+  uint32_t m_nBPM = 0;
+  uint16_t m_nDivision = 0; // Ticks per quarter note, or SMPTE timing (see IsSMPTE)
+  bool bVerbose = true;
+
+  // Called from inside Parse as soon as each track's notes are complete, and
+  // returning false abandons the parse. The tempo map is only built once
+  // every track has been read.
+  std::function < bool(const MidiFile &, size_t) > OnTrackParsed;
+
+  // Checked before every event, so another thread can abandon a parse in
+  // the middle of a long track. Parse returns false once it is set.
+  const std::atomic < bool > * pCancel = nullptr;
+
+};
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "MidiFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+/* An n-gram melody model over (interval, duration) tokens.
+ *
+ * Each monophonic line pulled out of a parsed MidiTrack is turned into a
+ * sequence of tokens: the interval in semitones from the previous note, and
+ * the time until the next note quantised to sixteenth-note steps. Counts for
+ * every context of length 0..ORDER-1 are kept in one open-addressing hash
+ * table, so backing off to a shorter context is just another lookup.
+ */
+struct MidiToken {
+  static constexpr int MaxInterval = 24; // Semitones, either direction
+  static constexpr int MaxSteps = 32;    // Sixteenths, i.e. two bars of 4/4
+  static constexpr uint32_t Count = (2 * MaxInterval + 1) * MaxSteps;
+
+  int8_t nInterval = 0;
+  uint8_t nSteps = 1;
+
+  uint16_t Pack() const {
+    return uint16_t((nInterval + MaxInterval) * MaxSteps + (nSteps - 1));
+  }
+
+  static MidiToken Unpack(uint16_t n) {
+    return { int8_t(int(n / MaxSteps) - MaxInterval), uint8_t(n % MaxSteps + 1) };
+  }
+};
+
+/* Flat hash table of 64-bit keys to counts. Keys are never removed, so plain
+ * linear probing with a power-of-two capacity is all that is needed. Key 0 is
+ * reserved to mark empty slots.
+ */
+class MidiCountTable {
+  public: struct Entry {
+    uint64_t nKey = 0;
+    uint32_t nValue = 0;
+  };
+
+  MidiCountTable(size_t nCapacity = 1024) {
+    size_t n = 16;
+    while (n < nCapacity) n <<= 1;
+    vecSlots.resize(n);
+  }
+
+  uint32_t & operator[](uint64_t nKey) {
+    if ((nUsed + 1) * 4 > vecSlots.size() * 3) Grow();
+    Entry & e = Probe(nKey);
+    if (e.nKey == 0) {
+      e.nKey = nKey;
+      nUsed++;
+    }
+    return e.nValue;
+  }
+
+  const Entry * Find(uint64_t nKey) const {
+    const Entry & e = const_cast < MidiCountTable * > (this) -> Probe(nKey);
+    return e.nKey == 0 ? nullptr : & e;
+  }
+
+  void Merge(const MidiCountTable & other) {
+    for (auto & e: other.vecSlots)
+      if (e.nKey != 0) ( * this)[e.nKey] += e.nValue;
+  }
+
+  size_t size() const {
+    return nUsed;
+  }
+  const std::vector < Entry > & Slots() const {
+    return vecSlots;
+  }
+
+  private: Entry & Probe(uint64_t nKey) {
+    size_t nMask = vecSlots.size() - 1;
+    size_t i = Hash(nKey) & nMask;
+    while (vecSlots[i].nKey != 0 && vecSlots[i].nKey != nKey)
+      i = (i + 1) & nMask;
+    return vecSlots[i];
+  }
+
+  void Grow() {
+    std::vector < Entry > vecOld(vecSlots.size() * 2);
+    vecOld.swap(vecSlots);
+    nUsed = 0;
+    for (auto & e: vecOld)
+      if (e.nKey != 0) ( * this)[e.nKey] = e.nValue;
+  }
+
+  static uint64_t Hash(uint64_t n) {
+    // splitmix64 finaliser
+    n ^= n >> 30;
+    n *= 0xbf58476d1ce4e5b9ull;
+    n ^= n >> 27;
+    n *= 0x94d049bb133111ebull;
+    return n ^ (n >> 31);
+  }
+
+  std::vector < Entry > vecSlots;
+  size_t nUsed = 0;
+};
+
+template < int ORDER = 3 >
+class MidiMelodyModel {
+  static_assert(ORDER >= 1 && ORDER <= 5, "Contexts are packed 11 bits per token into 64 bits");
+
+  // Key layout: [order+1:4][context tokens:11 bits each][next token:11]
+  public: static constexpr int TokenBits = 11;
+  static constexpr uint64_t TokenMask = (1u << TokenBits) - 1;
+
+  static uint64_t ContextKey(const uint16_t * pContext, int nOrder) {
+    uint64_t nKey = uint64_t(nOrder + 1) << 60;
+    for (int i = 0; i < nOrder; i++)
+      nKey |= uint64_t(pContext[i]) << (TokenBits * (i + 1));
+    return nKey;
+  }
+
+  // Adds every token transition found in the notes of a single track. SMPTE
+  // divisions have no quarter note to measure steps in, so are skipped.
+  static void Count(MidiCountTable & table, const MidiTrack & track, uint16_t nDivision) {
+    if (track.vecNotes.size() < 2 || nDivision == 0 || (nDivision & 0x8000)) return;
+
+    // Reduce to a monophonic line by keeping the highest key at each onset
+    std::vector < MidiNote > vecLine(track.vecNotes);
+    std::sort(vecLine.begin(), vecLine.end(), [](const MidiNote & a,
+      const MidiNote & b) {
+      return a.nStartTime < b.nStartTime || (a.nStartTime == b.nStartTime && a.nKey > b.nKey);
+    });
+    vecLine.erase(std::unique(vecLine.begin(), vecLine.end(), [](const MidiNote & a,
+      const MidiNote & b) {
+      return a.nStartTime == b.nStartTime;
+    }), vecLine.end());
+
+    uint32_t nStep = std::max < uint32_t > (1, nDivision / 4);
+    uint16_t nHistory[ORDER] {
+      0
+    };
+    int nHistoryLength = 0;
+
+    for (size_t i = 1; i + 1 < vecLine.size(); i++) {
+      int nInterval = int(vecLine[i].nKey) - int(vecLine[i - 1].nKey);
+      uint32_t nGap = vecLine[i + 1].nStartTime - vecLine[i].nStartTime;
+      int nSteps = int((nGap + nStep / 2) / nStep);
+
+      // Leaps and rests outside the token range break the phrase
+      if (nInterval < -MidiToken::MaxInterval || nInterval > MidiToken::MaxInterval || nSteps > MidiToken::MaxSteps) {
+        nHistoryLength = 0;
+        continue;
+      }
+
+      MidiToken token {
+        int8_t(nInterval), uint8_t(std::max(1, nSteps))
+      };
+      uint16_t nToken = token.Pack();
+
+      for (int nOrder = 0; nOrder <= std::min(nHistoryLength, ORDER - 1); nOrder++) {
+        table[ContextKey(nHistory, nOrder) | nToken]++;
+      }
+
+      // Most recent token lives at index 0
+      for (int j = ORDER - 1; j > 0; j--) nHistory[j] = nHistory[j - 1];
+      nHistory[0] = nToken;
+      nHistoryLength = std::min(nHistoryLength + 1, ORDER - 1);
+    }
+  }
+
+  // Parses and counts the given files on up to nThreads workers
+  size_t Train(const std::vector < std::string > & vecFiles, unsigned nThreads = std::thread::hardware_concurrency()) {
+    nThreads = std::max(1u, std::min < unsigned > (nThreads, unsigned(vecFiles.size())));
+    std::atomic < size_t > nNextFile {
+      0
+    };
+    std::atomic < size_t > nParsed {
+      0
+    };
+    std::mutex muxMerge;
+
+    auto Worker = [ & ]() {
+      MidiCountTable local(4096);
+      for (size_t i = nNextFile++; i < vecFiles.size(); i = nNextFile++) {
+        MidiFile midi;
+        midi.bVerbose = false;
+        if (!midi.ParseFile(vecFiles[i])) continue;
+        for (auto & track: midi.vecTracks)
+          Count(local, track, midi.m_nDivision);
+        nParsed++;
+      }
+      std::lock_guard < std::mutex > lock(muxMerge);
+      table.Merge(local);
+    };
+
+    std::vector < std::thread > vecWorkers;
+    for (unsigned i = 1; i < nThreads; i++) vecWorkers.emplace_back(Worker);
+    Worker();
+    for (auto & t: vecWorkers) t.join();
+
+    Compile();
+    return nParsed;
+  }
+
+  bool Empty() const {
+    return vecSuccessors.empty();
+  }
+
+  /* Draws tokens from the model. Holds only fixed-size state and reads the
+   * compiled model, so any number of samplers can run at once and none of
+   * them ever allocate.
+   */
+  class Sampler {
+    public: Sampler(const MidiMelodyModel & model, uint32_t nSeed): model(model), nState(nSeed ? nSeed : 0x9E3779B9u) {}
+
+    MidiToken Next() {
+      for (int nOrder = std::min(nHistoryLength, ORDER - 1); nOrder >= 0; nOrder--) {
+        const MidiCountTable::Entry * e = model.index.Find(ContextKey(nHistory, nOrder));
+        if (e == nullptr) continue;
+
+        // Index entry points at [begin, begin + count) in the cumulative table
+        const Successor * pBegin = & model.vecSuccessors[e -> nValue];
+        const Successor * pEnd = pBegin + pBegin -> nCount;
+        uint32_t nTotal = (pEnd - 1) -> nCumulative;
+        uint32_t nPick = Random() % nTotal;
+        const Successor * s = std::upper_bound(pBegin, pEnd, nPick, [](uint32_t n,
+          const Successor & s) {
+          return n < s.nCumulative;
+        });
+
+        for (int j = ORDER - 1; j > 0; j--) nHistory[j] = nHistory[j - 1];
+        nHistory[0] = s -> nToken;
+        nHistoryLength = std::min(nHistoryLength + 1, ORDER - 1);
+        return MidiToken::Unpack(s -> nToken);
+      }
+      return MidiToken {};
+    }
+
+    void Reset() {
+      nHistoryLength = 0;
+    }
+
+    private: uint32_t Random() {
+      // xorshift32
+      nState ^= nState << 13;
+      nState ^= nState >> 17;
+      nState ^= nState << 5;
+      return nState;
+    }
+
+    const MidiMelodyModel & model;
+    uint16_t nHistory[ORDER] {
+      0
+    };
+    int nHistoryLength = 0;
+    uint32_t nState;
+  };
+
+  private: struct Successor {
+    uint16_t nToken = 0;
+    uint32_t nCount = 0; // Only meaningful on the first successor of a context
+    uint32_t nCumulative = 0;
+  };
+
+  // Lays successors out contiguously per context with running totals, so a
+  // sample is one hash lookup plus a binary search
+  void Compile() {
+    std::vector < MidiCountTable::Entry > vecEntries;
+    vecEntries.reserve(table.size());
+    for (auto & e: table.Slots())
+      if (e.nKey != 0) vecEntries.push_back(e);
+    std::sort(vecEntries.begin(), vecEntries.end(), [](const MidiCountTable::Entry & a,
+      const MidiCountTable::Entry & b) {
+      return a.nKey < b.nKey;
+    });
+
+    vecSuccessors.clear();
+    vecSuccessors.reserve(vecEntries.size());
+    index = MidiCountTable(vecEntries.size() / 2);
+
+    size_t nBegin = 0;
+    for (size_t i = 0; i < vecEntries.size(); i++) {
+      uint64_t nContext = vecEntries[i].nKey & ~TokenMask;
+      if (i == 0 || nContext != (vecEntries[i - 1].nKey & ~TokenMask)) {
+        nBegin = vecSuccessors.size();
+        index[nContext] = uint32_t(nBegin);
+      }
+      Successor s;
+      s.nToken = uint16_t(vecEntries[i].nKey & TokenMask);
+      s.nCumulative = (vecSuccessors.size() > nBegin ? vecSuccessors.back().nCumulative : 0) + vecEntries[i].nValue;
+      vecSuccessors.push_back(s);
+      vecSuccessors[nBegin].nCount++;
+    }
+  }
+
+  MidiCountTable table {
+    4096
+  };
+  MidiCountTable index;
+  std::vector < Successor > vecSuccessors;
+};
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <queue>
+#include <ostream>
+
+typedef unsigned char byte;
+
+class MIDIvec : public std::vector<byte>
+{
+public:
+    template <typename... Args>
+    void AddBytes(byte data, Args... args)
+    {
+        push_back(data);
+        AddBytes(args...);
+    }
+    template <typename... Args>
+    void AddBytes(const char *s, Args... args)
+    {
+        insert(end(), s, s + std::strlen(s));
+        AddBytes(args...);
+    }
+    void AddBytes() {}
+};
+
+class MIDItrack : public MIDIvec
+{
+protected:
+    unsigned delay, running_status;
+
+public:
+    MIDItrack()
+        : MIDIvec(), delay(0), running_status(0)
+    {
+    }
+
+    void AddDelay(unsigned amount) { delay += amount; }
+
+    void AddVarLen(unsigned t)
+    {
+        if (t >> 21)
+            AddBytes(0x80 | ((t >> 21) & 0x7F));
+        if (t >> 14)
+            AddBytes(0x80 | ((t >> 14) & 0x7F));
+        if (t >> 7)
+            AddBytes(0x80 | ((t >> 7) & 0x7F));
+        AddBytes(((t >> 0) & 0x7F));
+    }
+
+    void Flush()
+    {
+        AddVarLen(delay);
+        delay = 0;
+    }
+
+    template <typename... Args>
+    void AddEvent(byte data, Args... args)
+    {
+        Flush();
+        if (data != running_status)
+            AddBytes(running_status = data);
+        AddBytes(args...);
+    }
+    void AddEvent() {}
+
+    // Appends events encoded into another track as if they had been added
+    // here. Only the run's first delta time is re-encoded, on top of any
+    // delay pending in this track; the rest of the bytes are copied as-is.
+    void AddRun(const MIDItrack &run)
+    {
+        if (!run.empty())
+        {
+            unsigned pos = 0, lead = 0;
+            do
+                lead = (lead << 7) | (run[pos] & 0x7F);
+            while (run[pos++] & 0x80);
+            AddDelay(lead);
+            Flush();
+            insert(end(), run.begin() + pos, run.end());
+            running_status = run.running_status;
+        }
+        AddDelay(run.delay);
+    }
+
+    template <typename... Args>
+    void AddMetaEvent(byte metatype, byte nbytes, Args... args)
+    {
+        Flush();
+        // Meta events cancel running status
+        running_status = 0;
+        AddBytes(0xFF, metatype, nbytes, args...);
+    }
+
+    // Key-related parameters: channel number, note number, pressure
+    void KeyOn(int ch, int n, int p)
+    {
+        if (n >= 0)
+            AddEvent(0x90 | ch, n, p);
+    }
+    void KeyOff(int ch, int n, int p)
+    {
+        if (n >= 0)
+            AddEvent(0x80 | ch, n, p);
+    }
+    void KeyTouch(int ch, int n, int p)
+    {
+        if (n >= 0)
+            AddEvent(0xA0 | ch, n, p);
+    }
+    // Events with other types of parameters:
+    void Control(int ch, int c, int v) { AddEvent(0xB0 | ch, c, v); }
+    void Patch(int ch, int patchno) { AddEvent(0xC0 | ch, patchno); }
+    void Wheel(int ch, unsigned value) { AddEvent(0xE0 | ch, value & 0x7F, (value >> 7) & 0x7F); }
+
+    void AddText(int texttype, const char *text)
+    {
+        AddMetaEvent(texttype, std::strlen(text), text);
+    }
+};
+
+class MIDIfile : public MIDIvec
+{
+protected:
+    std::vector<MIDItrack> tracks;
+    unsigned deltaticks, tempo;
+
+public:
+    MIDIfile()
+        : MIDIvec(), tracks(), deltaticks(1000), tempo(1000000)
+    {
+    }
+    void AddLoopStart() { (*this)[0].AddText(6, "loopStart"); }
+    void AddLoopEnd() { (*this)[0].AddText(6, "loopEnd"); }
+
+    MIDItrack &operator[](unsigned trackno)
+    {
+        if (trackno >= tracks.size())
+        {
+            tracks.reserve(16);
+            tracks.resize(trackno + 1);
+        }
+
+        MIDItrack &result = tracks[trackno];
+        if (result.empty())
+        {
+            //      time signature: 4/4
+            //      ticks/metro:    32
+            //      32nd per 1/4:   8
+            result.AddMetaEvent(0x58, 4, 4, 4, 32, 8);
+            // Meta 0x51 (tempo):
+            result.AddMetaEvent(0x51, 3, tempo >> 16, tempo >> 8, tempo);
+        }
+        return result;
+    }
+
+    unsigned TrackCount() const { return tracks.size(); }
+
+    /* Only the header chunk is built here; the track bodies stay where they
+     * were encoded and Write() sends them straight from there, so finishing
+     * a file never copies its event data.
+     */
+    void Finish()
+    {
+        clear();
+        AddBytes(
+            // MIDI signature (MThd and number 6)
+            "MThd", 0, 0, 0, 6,
+            // Format number (1: multiple tracks, synchronous)
+            0, 1,
+            tracks.size() >> 8, tracks.size(),
+            deltaticks >> 8, deltaticks);
+        for (unsigned a = 0; a < tracks.size(); ++a)
+        {
+            // Add meta 0x2F to the track, indicating the track end:
+            tracks[a].AddMetaEvent(0x2F, 0);
+        }
+    }
+
+    // Writes the finished header followed by each MTrk chunk
+    bool Write(std::FILE *fp) const
+    {
+        bool ok = std::fwrite(data(), 1, size(), fp) == size();
+        for (unsigned a = 0; ok && a < tracks.size(); ++a)
+        {
+            unsigned n = tracks[a].size();
+            const byte chunk[8] = {'M', 'T', 'r', 'k', byte(n >> 24), byte(n >> 16), byte(n >> 8), byte(n)};
+            ok = std::fwrite(chunk, 1, 8, fp) == 8 && std::fwrite(tracks[a].data(), 1, n, fp) == n;
+        }
+        return ok;
+    }
+    bool Write(std::ostream &os) const
+    {
+        os.write(reinterpret_cast<const char *>(data()), size());
+        for (unsigned a = 0; a < tracks.size(); ++a)
+        {
+            unsigned n = tracks[a].size();
+            const char chunk[8] = {'M', 'T', 'r', 'k', char(n >> 24), char(n >> 16), char(n >> 8), char(n)};
+            os.write(chunk, 8);
+            os.write(reinterpret_cast<const char *>(tracks[a].data()), n);
+        }
+        return bool(os);
+    }
+};
+
+/* Collects timed events from any number of voices and writes them into a
+ * track in time order, so delays are only emitted between real events.
+ * Voices can start notes at any tick and hold them for any duration.
+ */
+class MIDIscheduler
+{
+protected:
+    // At equal times, key-offs go first so a voice can retrigger the same key
+    enum Kind : byte { Off, Meta, On };
+
+    struct Event
+    {
+        unsigned time, seq;
+        byte kind, status, data1, data2;
+        const char *text;
+    };
+    struct Later
+    {
+        bool operator()(const Event &a, const Event &b) const
+        {
+            if (a.time != b.time)
+                return a.time > b.time;
+            if (a.kind != b.kind)
+                return a.kind > b.kind;
+            return a.seq > b.seq;
+        }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, Later> queue;
+    unsigned seq;
+
+    void Push(unsigned time, byte kind, byte status, byte data1, byte data2, const char *text = nullptr)
+    {
+        queue.push(Event{time, seq++, kind, status, data1, data2, text});
+    }
+
+public:
+    MIDIscheduler()
+        : queue(), seq(0)
+    {
+    }
+
+    // Key-related parameters: start tick, length in ticks, channel number, note number, pressure
+    void Note(unsigned time, unsigned duration, int ch, int n, int p, int offp = 0x20)
+    {
+        if (n < 0)
+            return;
+        Push(time, On, 0x90 | ch, n, p);
+        Push(time + duration, Off, 0x80 | ch, n, offp);
+    }
+    void Text(unsigned time, int texttype, const char *text)
+    {
+        Push(time, Meta, texttype, 0, 0, text);
+    }
+
+    bool empty() const { return queue.empty(); }
+
+    // Writes every queued event into the track and pads it out to the given end tick
+    void Drain(MIDItrack &track, unsigned end = 0)
+    {
+        unsigned now = 0;
+        while (!queue.empty())
+        {
+            const Event &e = queue.top();
+            track.AddDelay(e.time - now);
+            now = e.time;
+            if (e.kind == Meta)
+                track.AddText(e.status, e.text);
+            else
+                track.AddEvent(e.status, e.data1, e.data2);
+            queue.pop();
+        }
+        if (end > now)
+            track.AddDelay(end - now);
+    }
+};
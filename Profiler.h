@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/* Frame profiler for the viewer. Scopes are timed with steady_clock and the
+ * last nCapacity of them are kept in a ring buffer, which can be written out
+ * as CSV or as Chrome trace JSON (chrome://tracing, Perfetto). Per-scope
+ * averages over recent frames are kept for an on-screen overlay.
+ *
+ * Scope names must be string literals or otherwise outlive the profiler,
+ * since only the pointer is stored. Not thread safe: one profiler per thread.
+ */
+class Profiler {
+  public: struct Event {
+    const char * sName = nullptr;
+    uint64_t nStart = 0; // ns since the profiler was made
+    uint64_t nDuration = 0; // ns
+    uint32_t nFrame = 0;
+    uint32_t nDepth = 0;
+  };
+
+  struct Stat {
+    const char * sName = nullptr;
+    double dFrame = 0.0; // ms so far this frame
+    double dAverage = 0.0; // ms, exponential moving average over frames
+  };
+
+  // Times the enclosing block
+  class Scope {
+    public: Scope(Profiler & profiler,
+      const char * sName): profiler(profiler), sName(sName), nStart(profiler.Now()) {
+      profiler.nDepth++;
+    }
+    ~Scope() {
+      profiler.nDepth--;
+      profiler.Record(sName, nStart, profiler.Now() - nStart);
+    }
+
+    private: Profiler & profiler;
+    const char * sName;
+    uint64_t nStart;
+  };
+
+  Profiler(size_t nCapacity = 65536): vecEvents(nCapacity) {}
+
+  uint64_t Now() const {
+    return uint64_t(std::chrono::duration_cast < std::chrono::nanoseconds > (std::chrono::steady_clock::now() - tpOrigin).count());
+  }
+
+  // Records a span measured elsewhere, e.g. time spent outside the app
+  void Record(const char * sName, uint64_t nStart, uint64_t nDuration) {
+    Event & e = vecEvents[nNext];
+    e.sName = sName;
+    e.nStart = nStart;
+    e.nDuration = nDuration;
+    e.nFrame = nFrame;
+    e.nDepth = nDepth;
+    nNext = (nNext + 1) % vecEvents.size();
+    nCount = std::min(nCount + 1, vecEvents.size());
+
+    Stat * pStat = nullptr;
+    for (auto & s: vecStats)
+      if (s.sName == sName) pStat = & s;
+    if (pStat == nullptr) {
+      vecStats.push_back({ sName });
+      pStat = & vecStats.back();
+    }
+    pStat -> dFrame += nDuration * 1e-6;
+  }
+
+  // Folds this frame's per-scope totals into the averages
+  void EndFrame() {
+    for (auto & s: vecStats) {
+      s.dAverage += (s.dFrame - s.dAverage) * 0.05;
+      s.dFrame = 0.0;
+    }
+    nFrame++;
+  }
+
+  const std::vector < Stat > & Stats() const {
+    return vecStats;
+  }
+
+  // Oldest first
+  template < typename F >
+    void ForEachEvent(F && fn) const {
+      size_t nFirst = (nNext + vecEvents.size() - nCount) % vecEvents.size();
+      for (size_t i = 0; i < nCount; i++) fn(vecEvents[(nFirst + i) % vecEvents.size()]);
+    }
+
+  bool WriteCSV(const std::string & sFileName) const {
+    FILE * fp = std::fopen(sFileName.c_str(), "w");
+    if (!fp) return false;
+    std::fprintf(fp, "frame,scope,depth,start_us,duration_us\n");
+    ForEachEvent([ & ](const Event & e) {
+      std::fprintf(fp, "%u,%s,%u,%.3f,%.3f\n", e.nFrame, e.sName, e.nDepth, e.nStart * 1e-3, e.nDuration * 1e-3);
+    });
+    return std::fclose(fp) == 0;
+  }
+
+  // Complete ("X") events on one thread, which trace viewers nest by time
+  bool WriteChromeTrace(const std::string & sFileName) const {
+    FILE * fp = std::fopen(sFileName.c_str(), "w");
+    if (!fp) return false;
+    std::fprintf(fp, "{\"traceEvents\":[");
+    bool bFirst = true;
+    ForEachEvent([ & ](const Event & e) {
+      std::fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"frame\":%u}}", bFirst ? "" : ",", e.sName, e.nStart * 1e-3, e.nDuration * 1e-3, e.nFrame);
+      bFirst = false;
+    });
+    std::fprintf(fp, "\n]}\n");
+    return std::fclose(fp) == 0;
+  }
+
+  private: std::chrono::steady_clock::time_point tpOrigin = std::chrono::steady_clock::now();
+  std::vector < Event > vecEvents;
+  size_t nNext = 0;
+  size_t nCount = 0;
+  uint32_t nFrame = 0;
+  uint32_t nDepth = 0;
+  std::vector < Stat > vecStats;
+};
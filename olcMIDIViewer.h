@@ -0,0 +1,862 @@
+#pragma once
+
+#include "olcPixelGameEngine.h"
+#include "MidiFile.h"
+#include "Profiler.h"
+#include <fstream>
+#include <array>
+#include <map>
+#include <memory>
+#include <climits>
+#include <thread>
+#include <atomic>
+
+/* Pre-aggregated view of a track for zoomed-out drawing. Level 0 splits time
+ * into buckets of 2^nBaseShift ticks, and each level above merges pairs of
+ * buckets. Every occupied (pitch row, bucket) cell holds how many notes touch
+ * it and the velocity and channel of the loudest, so a frame can be drawn
+ * from a level whose buckets are about one pixel wide at a cost set by the
+ * screen width. Only occupied cells are stored, so a track costs memory in
+ * proportion to what it plays rather than to its pitch range times length.
+ */
+struct NotePyramid {
+  struct Cell {
+    uint16_t nCount = 0; // Notes touching the bucket, saturating; 0 means empty
+    uint8_t nMaxVelocity = 0;
+    uint8_t nChannel = 0; // Of the loudest note
+
+    void Loudest(uint8_t nVelocity, uint8_t nNoteChannel) {
+      if (nVelocity <= nMaxVelocity) return;
+      nMaxVelocity = nVelocity;
+      nChannel = nNoteChannel;
+    }
+
+    void Merge(const Cell & other) {
+      nCount = uint16_t(std::min < uint32_t > (UINT16_MAX, uint32_t(nCount) + other.nCount));
+      Loudest(other.nMaxVelocity, other.nChannel);
+    }
+  };
+
+  // Occupied buckets row by row, each row in bucket order: row r is entries
+  // vecRowStart[r] to vecRowStart[r + 1] of vecBuckets and vecCells
+  struct Level {
+    uint32_t nBuckets = 0;
+    std::vector < uint32_t > vecRowStart;
+    std::vector < uint32_t > vecBuckets;
+    std::vector < Cell > vecCells;
+  };
+
+  uint32_t nBaseShift = 0;
+  uint32_t nRows = 0;
+  std::vector < Level > vecLevels;
+
+  void Build(const MidiTrack & track) {
+    vecLevels.clear();
+    if (track.vecNotes.empty()) return;
+
+    uint64_t nEnd = 0;
+    for (auto & note: track.vecNotes) nEnd = std::max < uint64_t > (nEnd, uint64_t(note.nStartTime) + note.nDuration);
+
+    // Keep level 0 to at most 16k buckets per row
+    nBaseShift = 4;
+    while ((nEnd >> nBaseShift) >= 16384) nBaseShift++;
+    nRows = track.nMaxNote - track.nMinNote + 1;
+
+    // Group the notes by row, then fill level 0 a row at a time through one
+    // dense scratch row, keeping only the buckets that were touched
+    std::vector < uint32_t > vecRowNotes(nRows + 1, 0), vecOrder(track.vecNotes.size());
+    for (auto & note: track.vecNotes) vecRowNotes[note.nKey - track.nMinNote + 1]++;
+    for (uint32_t r = 0; r < nRows; r++) vecRowNotes[r + 1] += vecRowNotes[r];
+    std::vector < uint32_t > vecFill(vecRowNotes.begin(), vecRowNotes.end() - 1);
+    for (uint32_t i = 0; i < track.vecNotes.size(); i++) vecOrder[vecFill[track.vecNotes[i].nKey - track.nMinNote]++] = i;
+
+    Level base;
+    base.nBuckets = uint32_t(nEnd >> nBaseShift) + 1;
+    base.vecRowStart.resize(nRows + 1);
+    std::vector < Cell > vecScratch(base.nBuckets);
+    for (uint32_t r = 0; r < nRows; r++) {
+      base.vecRowStart[r] = uint32_t(base.vecBuckets.size());
+      uint32_t nLow = UINT32_MAX, nHigh = 0;
+      for (uint32_t i = vecRowNotes[r]; i < vecRowNotes[r + 1]; i++) {
+        auto & note = track.vecNotes[vecOrder[i]];
+        uint32_t b0 = note.nStartTime >> nBaseShift;
+        uint32_t b1 = uint32_t((uint64_t(note.nStartTime) + note.nDuration) >> nBaseShift);
+        for (uint32_t b = b0; b <= b1; b++) {
+          if (vecScratch[b].nCount < UINT16_MAX) vecScratch[b].nCount++;
+          vecScratch[b].Loudest(note.nVelocity, note.nChannel);
+        }
+        nLow = std::min(nLow, b0);
+        nHigh = std::max(nHigh, b1);
+      }
+      for (uint32_t b = nLow; b <= nHigh && nLow != UINT32_MAX; b++) {
+        if (vecScratch[b].nCount == 0) continue;
+        base.vecBuckets.push_back(b);
+        base.vecCells.push_back(vecScratch[b]);
+        vecScratch[b] = Cell();
+      }
+    }
+    base.vecRowStart[nRows] = uint32_t(base.vecBuckets.size());
+    vecLevels.push_back(std::move(base));
+
+    while (vecLevels.back().nBuckets > 1) {
+      const Level & child = vecLevels.back();
+      Level level;
+      level.nBuckets = (child.nBuckets + 1) / 2;
+      level.vecRowStart.resize(nRows + 1);
+      for (uint32_t r = 0; r < nRows; r++) {
+        level.vecRowStart[r] = uint32_t(level.vecBuckets.size());
+        for (uint32_t i = child.vecRowStart[r]; i < child.vecRowStart[r + 1]; i++) {
+          uint32_t b = child.vecBuckets[i] / 2;
+          if (level.vecBuckets.size() > level.vecRowStart[r] && level.vecBuckets.back() == b)
+            level.vecCells.back().Merge(child.vecCells[i]);
+          else {
+            level.vecBuckets.push_back(b);
+            level.vecCells.push_back(child.vecCells[i]);
+          }
+        }
+      }
+      level.vecRowStart[nRows] = uint32_t(level.vecBuckets.size());
+      vecLevels.push_back(std::move(level));
+    }
+  }
+
+  // Whether the buckets are fine enough to draw at this zoom. Any closer and
+  // a bucket spans several columns, so the notes themselves must be drawn.
+  bool Resolves(uint32_t nTimePerColumn) const {
+    return !vecLevels.empty() && nTimePerColumn >= (uint32_t(1) << nBaseShift);
+  }
+
+  /* Calls fn(x0, x1, row, cell) for each run of occupied columns
+   * [x0, x1) in each pitch row, where column x covers the ticks
+   * [nTimeStart + x * nTimePerColumn, nTimeStart + (x + 1) * nTimePerColumn),
+   * and cell holds the loudest note in the run.
+   */
+  template < typename F >
+    void ForEachSpan(int64_t nTimeStart, uint32_t nTimePerColumn, int32_t nColumns, F && fn) const {
+      if (vecLevels.empty() || nColumns <= 0 || nTimePerColumn == 0) return;
+
+      // Coarsest level whose buckets are no wider than a column
+      uint32_t nLevel = 0;
+      while (nLevel + 1 < vecLevels.size() && (uint64_t(1) << (nBaseShift + nLevel + 1)) <= nTimePerColumn) nLevel++;
+      const Level & level = vecLevels[nLevel];
+      uint32_t nShift = nBaseShift + nLevel;
+      int64_t nTimeEnd = nTimeStart + int64_t(nColumns) * nTimePerColumn;
+      uint64_t nFirst = uint64_t(std::max < int64_t > (0, nTimeStart)) >> nShift;
+
+      // Each occupied bucket in the window covers a range of columns, and
+      // ranges that touch or overlap join into one run
+      for (uint32_t r = 0; r < nRows; r++) {
+        auto itRowEnd = level.vecBuckets.begin() + level.vecRowStart[r + 1];
+        auto it = std::lower_bound(level.vecBuckets.begin() + level.vecRowStart[r], itRowEnd, nFirst, [](uint32_t b, uint64_t n) {
+          return b < n;
+        });
+        int32_t x0 = -1, x1 = -1;
+        Cell run;
+        for (; it != itRowEnd; ++it) {
+          int64_t t0 = int64_t(* it) << nShift;
+          int64_t t1 = t0 + (int64_t(1) << nShift) - 1;
+          if (t0 >= nTimeEnd) break;
+          if (t1 < nTimeStart) continue;
+          int32_t c0 = t0 <= nTimeStart ? 0 : int32_t((t0 - nTimeStart) / nTimePerColumn);
+          int32_t c1 = int32_t(std::min < int64_t > (nColumns - 1, (t1 - nTimeStart) / nTimePerColumn));
+          if (x0 >= 0 && c0 > x1) {
+            fn(x0, x1, r, run);
+            x0 = -1;
+          }
+          if (x0 < 0) {
+            x0 = c0;
+            run = Cell();
+          }
+          x1 = std::max(x1, c1 + 1);
+          const Cell & cell = level.vecCells[it - level.vecBuckets.begin()];
+          run.Loudest(cell.nMaxVelocity, cell.nChannel);
+        }
+        if (x0 >= 0) fn(x0, x1, r, run);
+      }
+    }
+};
+
+/* Everything the viewer draws from. A snapshot is never changed once it is
+ * published, so the loader thread can hand over a new one with an atomic
+ * pointer swap while the UI keeps drawing from the old one.
+ */
+struct MidiSnapshot {
+  std::string sFileName;
+  uint32_t nGeneration = 0; // Bumped for every file loaded
+  MidiFile midi; // Tempo map and division only, the tracks are below
+  // Tracks, notes only, and their density pyramids, which are used instead
+  // of the notes when a window holds more notes than it has pixel columns.
+  // Later snapshots of the same load share them, so publishing a track adds
+  // one of each rather than copying the ones before it.
+  std::vector < std::shared_ptr < const MidiTrack >> vecTracks;
+  std::vector < std::shared_ptr < const NotePyramid >> vecPyramids;
+  bool bComplete = false;
+  bool bFailed = false;
+
+  // Adds a track, copying its notes but not its raw events
+  void AddTrack(const MidiTrack & track) {
+    auto pTrack = std::make_shared < MidiTrack > ();
+    pTrack -> sName = track.sName;
+    pTrack -> sInstrument = track.sInstrument;
+    pTrack -> vecNotes = track.vecNotes;
+    pTrack -> nMaxNote = track.nMaxNote;
+    pTrack -> nMinNote = track.nMinNote;
+    pTrack -> nMaxDuration = track.nMaxDuration;
+    auto pPyramid = std::make_shared < NotePyramid > ();
+    pPyramid -> Build( * pTrack);
+    vecTracks.push_back(std::move(pTrack));
+    vecPyramids.push_back(std::move(pPyramid));
+  }
+
+  // Takes the timing of everything parsed so far and rebuilds the tempo map
+  void SetTiming(const MidiFile & file) {
+    midi.vecTempo = file.vecTempo;
+    midi.m_nTempo = file.m_nTempo;
+    midi.m_nBPM = file.m_nBPM;
+    midi.m_nDivision = file.m_nDivision;
+    midi.BuildTempoMap();
+  }
+};
+
+class olcMIDIViewer: public olc::PixelGameEngine {
+  public: olcMIDIViewer() {
+    sAppName = "MIDI File Viewer";
+    BakePalette();
+  }
+
+  ~olcMIDIViewer() {
+    StopLoading();
+  }
+
+  // The song on screen. Only the UI thread touches pSong; pPublished is the
+  // loader's latest snapshot and is only accessed through std::atomic_load
+  // and std::atomic_store.
+  std::shared_ptr < const MidiSnapshot > pSong = std::make_shared < MidiSnapshot > ();
+  std::shared_ptr < const MidiSnapshot > pPublished;
+  std::thread threadLoader;
+  std::atomic < bool > bCancelLoad {
+    false
+  };
+  uint32_t nGenerations = 0;
+  std::string sInitialFile = "ff7_battle.mid";
+
+  //HMIDIOUT hInstrument;
+
+  // Playback. Song time is driven by a monotonic clock and converted to
+  // ticks through the file's tempo map. Each track keeps a cursor at its
+  // first note not yet started and the list of notes currently sounding, so
+  // advancing a frame only touches notes that start or end in it.
+  bool bPlaying = false;
+  std::chrono::steady_clock::time_point tpPlayStart;
+  double dPlayStartSongTime = 0.0;
+  std::vector < size_t > vecCurrentNote;
+  std::vector < std::vector < size_t >> vecSoundingNotes;
+
+  double dSongTime = 0.0;
+  double dRunTime = 0.0;
+  uint32_t nMidiClock = 0;
+
+  // Moves the playhead, O(log n) per track
+  void Seek(double dTime) {
+    dSongTime = std::max(0.0, dTime);
+    dPlayStartSongTime = dSongTime;
+    tpPlayStart = std::chrono::steady_clock::now();
+    dRunTime = 0.0;
+    nMidiClock = uint32_t(pSong -> midi.SecondsToTick(dSongTime));
+
+    vecCurrentNote.resize(pSong -> vecTracks.size());
+    vecSoundingNotes.resize(pSong -> vecTracks.size());
+    for (size_t t = 0; t < pSong -> vecTracks.size(); t++) {
+      auto & vecNotes = pSong -> vecTracks[t] -> vecNotes;
+      auto notes = VisibleNotes(* pSong -> vecTracks[t], nMidiClock, nMidiClock);
+      vecCurrentNote[t] = notes.second - vecNotes.begin();
+      vecSoundingNotes[t].clear();
+      for (auto it = notes.first; it != notes.second; ++it)
+        if (it -> nStartTime + it -> nDuration > nMidiClock) vecSoundingNotes[t].push_back(it - vecNotes.begin());
+    }
+  }
+
+  void AdvancePlayback() {
+    dRunTime = std::chrono::duration < double > (std::chrono::steady_clock::now() - tpPlayStart).count();
+    dSongTime = dPlayStartSongTime + dRunTime;
+    nMidiClock = uint32_t(pSong -> midi.SecondsToTick(dSongTime));
+
+    bool bFinished = true;
+    for (size_t t = 0; t < pSong -> vecTracks.size(); t++) {
+      auto & vecNotes = pSong -> vecTracks[t] -> vecNotes;
+      auto & vecSounding = vecSoundingNotes[t];
+      for (size_t i = 0; i < vecSounding.size();) {
+        auto & note = vecNotes[vecSounding[i]];
+        if (note.nStartTime + note.nDuration <= nMidiClock) {
+          vecSounding[i] = vecSounding.back();
+          vecSounding.pop_back();
+        } else i++;
+      }
+      size_t & nCursor = vecCurrentNote[t];
+      for (; nCursor < vecNotes.size() && vecNotes[nCursor].nStartTime <= nMidiClock; nCursor++)
+        if (vecNotes[nCursor].nStartTime + vecNotes[nCursor].nDuration > nMidiClock) vecSounding.push_back(nCursor);
+      bFinished = bFinished && nCursor == vecNotes.size() && vecSounding.empty();
+    }
+    if (bFinished) bPlaying = false;
+    FollowPlayhead();
+  }
+
+  // Keeps the playhead a quarter of the way across the screen
+  void FollowPlayhead() {
+    nTrackOffset = float(nMidiClock) - float(ScreenWidth() / 4) * nTimePerColumn;
+  }
+
+  float PlayheadX() const {
+    return (float(nMidiClock) - nTrackOffset) / nTimePerColumn;
+  }
+
+  // Parses a file on the calling thread and shows it
+  bool Load(const std::string & sFileName) {
+    Profiler::Scope scope(profiler, "load");
+    auto pNext = std::make_shared < MidiSnapshot > ();
+    pNext -> sFileName = sFileName;
+    pNext -> nGeneration = ++nGenerations;
+    MidiFile midi;
+    midi.bVerbose = false;
+    pNext -> bFailed = !midi.ParseFile(sFileName);
+    pNext -> bComplete = true;
+    for (auto & track: midi.vecTracks)
+      pNext -> AddTrack(track);
+    pNext -> SetTiming(midi);
+    ShowSnapshot(pNext);
+    return !pNext -> bFailed;
+  }
+
+  /* Parses a file on the loader thread, publishing a new snapshot each time
+   * a track is complete so the UI can show it straight away. Each snapshot
+   * shares the tracks before it and adds one. Starting another load cancels
+   * this one within an event of the parse, so the UI thread's join is short.
+   */
+  void StartLoading(const std::string & sFileName) {
+    StopLoading();
+    bCancelLoad = false;
+    uint32_t nGeneration = ++nGenerations;
+    threadLoader = std::thread([this, sFileName, nGeneration]() {
+      auto pLast = std::make_shared < MidiSnapshot > ();
+      pLast -> sFileName = sFileName;
+      pLast -> nGeneration = nGeneration;
+      std::atomic_store( & pPublished, std::shared_ptr < const MidiSnapshot > (pLast));
+      RequestRedraw();
+
+      auto Publish = [ & ](const MidiFile & midi, bool bComplete) {
+        auto pNext = std::make_shared < MidiSnapshot > ( * pLast);
+        for (size_t t = pNext -> vecTracks.size(); t < midi.vecTracks.size(); t++)
+          pNext -> AddTrack(midi.vecTracks[t]);
+        pNext -> SetTiming(midi);
+        pNext -> bComplete = bComplete;
+        std::atomic_store( & pPublished, std::shared_ptr < const MidiSnapshot > (pNext));
+        RequestRedraw();
+        pLast = pNext;
+      };
+
+      MidiFile midi;
+      midi.bVerbose = false;
+      midi.pCancel = & bCancelLoad;
+      midi.OnTrackParsed = [ & ](const MidiFile &, size_t) {
+        if (bCancelLoad) return false;
+        Publish(midi, false);
+        return true;
+      };
+      bool bParsed = midi.ParseFile(sFileName);
+      if (bCancelLoad) return;
+      Publish(midi, true);
+      if (!bParsed) {
+        auto pFailed = std::make_shared < MidiSnapshot > ( * pLast);
+        pFailed -> bFailed = true;
+        std::atomic_store( & pPublished, std::shared_ptr < const MidiSnapshot > (pFailed));
+        RequestRedraw();
+      }
+    });
+  }
+
+  void StopLoading() {
+    bCancelLoad = true;
+    if (threadLoader.joinable()) threadLoader.join();
+  }
+
+  // Picks up whatever the loader has published since the last frame
+  void PollLoader() {
+    auto pNext = std::atomic_load( & pPublished);
+    if (pNext && pNext != pSong) ShowSnapshot(pNext);
+  }
+
+  // Adopts a snapshot. A new file starts from the top, while more tracks of
+  // the same one keep the playhead, the scroll position and the cached tiles.
+  void ShowSnapshot(std::shared_ptr < const MidiSnapshot > pNext) {
+    bool bNewFile = pNext -> nGeneration != pSong -> nGeneration;
+    pSong = std::move(pNext);
+    vecTrackY.clear();
+    nLastScrollX = INT32_MIN;
+    if (bNewFile) {
+      vecTileCache.clear();
+      fScrollY = 0.0f;
+      bPlaying = false;
+      Seek(0.0);
+    } else Seek(dSongTime);
+  }
+
+  // Shown along the bottom while a file is loading or if it failed to
+  void DrawLoadStatus() {
+    std::string sStatus;
+    if (pSong -> bFailed) sStatus = "Could not load " + pSong -> sFileName;
+    else if (!pSong -> bComplete) sStatus = "Loading " + pSong -> sFileName + " (" + std::to_string(pSong -> vecTracks.size()) + " tracks)";
+    if (sStatus.empty()) return;
+    FillRect(0, ScreenHeight() - 12, int32_t(sStatus.size()) * 8 + 4, 12, olc::VERY_DARK_BLUE);
+    DrawString(2, ScreenHeight() - 10, sStatus, olc::WHITE);
+  }
+
+  public: bool OnUserCreate() override {
+
+    // A paused roll is only redrawn on input or when the loader publishes,
+    // so the viewer sleeps instead of spinning a core
+    SetRedrawOnChange(true);
+    SetFrameCap(60.0f);
+
+    // The window comes up straight away and the file fills in as it parses
+    if (!sInitialFile.empty()) StartLoading(sInitialFile);
+
+    /*
+    int nMidiDevices = midiOutGetNumDevs();
+    if (nMidiDevices > 0)
+    {
+    	if (midiOutOpen(&hInstrument, 2, NULL, 0, NULL) == MMSYSERR_NOERROR)
+    	{
+    		std::cout << "Opened midi" << std::endl;
+    	}
+    }
+    */
+
+    return true;
+  }
+
+  float nTrackOffset = 1000;
+  uint32_t nTimePerColumn = 50;
+  uint32_t nNoteHeight = 2;
+  float fScrollY = 0.0f;
+
+  // Note colours for every (slot, velocity), baked whenever the colour mode
+  // changes so colouring a note is one table lookup. The slot is the note's
+  // channel, or its track number when colouring by track.
+  enum class NoteColours {
+    Mono,
+    Channel,
+    Track
+  } colourMode = NoteColours::Channel;
+  std::array < olc::Pixel, 16 * 128 > palette;
+
+  static olc::Pixel FromHSV(float fHue, float fSaturation, float fValue) {
+    float fChroma = fValue * fSaturation;
+    float fSector = fHue / 60.0f;
+    float fX = fChroma * (1.0f - std::fabs(std::fmod(fSector, 2.0f) - 1.0f));
+    float r = 0.0f, g = 0.0f, b = 0.0f;
+    switch (int(fSector) % 6) {
+    case 0: r = fChroma; g = fX; break;
+    case 1: r = fX; g = fChroma; break;
+    case 2: g = fChroma; b = fX; break;
+    case 3: g = fX; b = fChroma; break;
+    case 4: r = fX; b = fChroma; break;
+    default: r = fChroma; b = fX; break;
+    }
+    float m = fValue - fChroma;
+    return olc::PixelF(r + m, g + m, b + m);
+  }
+
+  void BakePalette() {
+    for (uint32_t nSlot = 0; nSlot < 16; nSlot++) {
+      // Golden-angle hue steps keep neighbouring slots far apart
+      float fHue = std::fmod(float(nSlot) * 137.508f, 360.0f);
+      for (uint32_t nVelocity = 0; nVelocity < 128; nVelocity++) {
+        float fValue = 0.35f + 0.65f * float(nVelocity) / 127.0f;
+        palette[nSlot * 128 + nVelocity] = colourMode == NoteColours::Mono ? olc::WHITE : FromHSV(fHue, 0.65f, fValue);
+      }
+    }
+    vecTileCache.clear();
+  }
+
+  olc::Pixel NoteColour(size_t nTrack, uint8_t nChannel, uint8_t nVelocity) const {
+    size_t nSlot = colourMode == NoteColours::Track ? nTrack : nChannel;
+    return palette[(nSlot & 15) << 7 | (nVelocity & 127)];
+  }
+
+  // Top of each track in roll pixels and the height of the whole roll. Only
+  // recomputed when the note height or the file changes, so placing a track
+  // is a lookup, and finding the ones on screen a binary search.
+  std::vector < int32_t > vecTrackY;
+  int32_t nRollHeight = 0;
+  uint32_t nLayoutNoteHeight = 0;
+  int32_t nLastScrollY = INT32_MIN;
+
+  int32_t TrackHeight(size_t nTrack) const {
+    auto & track = * pSong -> vecTracks[nTrack];
+    if (track.vecNotes.empty()) return 0;
+    return int32_t(track.nMaxNote - track.nMinNote + 1) * int32_t(nNoteHeight);
+  }
+
+  void Layout() {
+    vecTrackY.resize(pSong -> vecTracks.size());
+    int32_t y = 0;
+    for (size_t t = 0; t < pSong -> vecTracks.size(); t++) {
+      vecTrackY[t] = y;
+      if (!pSong -> vecTracks[t] -> vecNotes.empty()) y += TrackHeight(t) + 4;
+    }
+    nRollHeight = y;
+    nLayoutNoteHeight = nNoteHeight;
+    ScrollBy(0.0f);
+  }
+
+  void ScrollBy(float fDelta) {
+    fScrollY = std::min(fScrollY + fDelta, float(std::max(0, nRollHeight - ScreenHeight())));
+    fScrollY = std::max(fScrollY, 0.0f);
+  }
+
+  // Tracks [first, last) overlap the rows [nScrollY, nScrollY + ScreenHeight())
+  std::pair < size_t, size_t > VisibleTracks(int32_t nScrollY) const {
+    size_t nFirst = std::upper_bound(vecTrackY.begin(), vecTrackY.end(), nScrollY) - vecTrackY.begin();
+    size_t nLast = std::lower_bound(vecTrackY.begin(), vecTrackY.end(), nScrollY + ScreenHeight()) - vecTrackY.begin();
+    return { nFirst > 0 ? nFirst - 1 : 0, nLast };
+  }
+
+  // The roll is rasterised into fixed-width tiles per track, and frames are
+  // composed by blitting whichever tiles overlap the screen. A tile is only
+  // drawn when it first scrolls into view or the zoom changes.
+  static constexpr int32_t nTileWidth = 256;
+  std::vector < std::map < int32_t, std::unique_ptr < olc::Sprite >>> vecTileCache;
+  uint32_t nCachedTimePerColumn = 0;
+  int32_t nLastScrollX = INT32_MIN;
+
+  // Only notes in the returned range can overlap [nWindowStart, nWindowEnd].
+  // Notes are sorted by start, and none lasts longer than nMaxDuration, so
+  // every visible note starts within [nWindowStart - nMaxDuration, nWindowEnd]
+  static std::pair < std::vector < MidiNote > ::const_iterator, std::vector < MidiNote > ::const_iterator > VisibleNotes(const MidiTrack & track, int64_t nWindowStart, int64_t nWindowEnd) {
+    int64_t nFirstStart = nWindowStart - int64_t(track.nMaxDuration);
+    auto itFirst = std::lower_bound(track.vecNotes.begin(), track.vecNotes.end(), nFirstStart, [](const MidiNote & n, int64_t t) {
+      return int64_t(n.nStartTime) < t;
+    });
+    auto itLast = std::upper_bound(itFirst, track.vecNotes.end(), nWindowEnd, [](int64_t t, const MidiNote & n) {
+      return t < int64_t(n.nStartTime);
+    });
+    return { itFirst, itLast };
+  }
+
+  void DrawTile(size_t nTrack, int32_t nTile, olc::Sprite * pTile) {
+    const MidiTrack & track = * pSong -> vecTracks[nTrack];
+    uint32_t nNoteRange = track.nMaxNote - track.nMinNote;
+    int64_t nTileX = int64_t(nTile) * nTileWidth;
+
+    olc::Sprite * pTarget = GetDrawTarget();
+    SetDrawTarget(pTile);
+    Clear(olc::DARK_GREY);
+
+    int64_t nWindowStart = nTileX * nTimePerColumn;
+    int64_t nWindowEnd = (nTileX + nTileWidth) * nTimePerColumn;
+    auto notes = VisibleNotes(track, nWindowStart, nWindowEnd);
+
+    // The pyramid only stands in for the notes when they crowd the columns
+    // and its buckets are no wider than a column
+    const NotePyramid & pyramid = * pSong -> vecPyramids[nTrack];
+    if (notes.second - notes.first > nTileWidth && pyramid.Resolves(nTimePerColumn)) {
+      pyramid.ForEachSpan(nWindowStart, nTimePerColumn, nTileWidth, [ & ](int32_t x0, int32_t x1, uint32_t nRow, const NotePyramid::Cell & cell) {
+        FillRect(x0, (nNoteRange - nRow) * nNoteHeight, x1 - x0, nNoteHeight, NoteColour(nTrack, cell.nChannel, cell.nMaxVelocity));
+      });
+    } else {
+      for (auto itNote = notes.first; itNote != notes.second; ++itNote) {
+        auto & note = * itNote;
+        if (int64_t(note.nStartTime) + note.nDuration < nWindowStart) continue;
+        FillRect(int32_t(note.nStartTime / nTimePerColumn - nTileX), (nNoteRange - (note.nKey - track.nMinNote)) * nNoteHeight, std::max < int32_t > (1, note.nDuration / nTimePerColumn), nNoteHeight, NoteColour(nTrack, note.nChannel, note.nVelocity));
+      }
+    }
+
+    SetDrawTarget(pTarget);
+  }
+
+  // Notes can instead be submitted to the GPU as one batched decal per
+  // track; headless builds composite decals on the CPU, where the tiles are
+  // cheaper, so always use the tiles
+#if defined(OLC_GFX_HEADLESS)
+  static constexpr bool bDecalAvailable = false;
+#else
+  static constexpr bool bDecalAvailable = true;
+#endif
+  bool bDecalNotes = bDecalAvailable;
+  std::vector < olc::vf2d > vecQuadPos;
+  std::vector < olc::vf2d > vecQuadUV;
+  std::vector < olc::Pixel > vecQuadCol;
+
+  void AddQuad(float x0, float y0, float x1, float y1, olc::Pixel col) {
+    // Two triangles per quad
+    vecQuadPos.insert(vecQuadPos.end(), {
+      { x0, y0 }, { x0, y1 }, { x1, y1 }, { x0, y0 }, { x1, y1 }, { x1, y0 }
+    });
+    vecQuadCol.insert(vecQuadCol.end(), 6, col);
+  }
+
+  void DrawTrackDecal(size_t nTrack, float fOffsetY) {
+    const MidiTrack & track = * pSong -> vecTracks[nTrack];
+    uint32_t nNoteRange = track.nMaxNote - track.nMinNote;
+    int64_t nWindowStart = int64_t(nTrackOffset);
+    int64_t nWindowEnd = nWindowStart + int64_t(ScreenWidth()) * nTimePerColumn;
+    auto notes = VisibleNotes(track, nWindowStart, nWindowEnd);
+
+    vecQuadPos.clear();
+    vecQuadCol.clear();
+    const NotePyramid & pyramid = * pSong -> vecPyramids[nTrack];
+    if (notes.second - notes.first > ScreenWidth() && pyramid.Resolves(nTimePerColumn)) {
+      pyramid.ForEachSpan(nWindowStart, nTimePerColumn, ScreenWidth(), [ & ](int32_t x0, int32_t x1, uint32_t nRow, const NotePyramid::Cell & cell) {
+        float y0 = fOffsetY + float((nNoteRange - nRow) * nNoteHeight);
+        AddQuad(float(x0), y0, float(x1), y0 + float(nNoteHeight), NoteColour(nTrack, cell.nChannel, cell.nMaxVelocity));
+      });
+    } else {
+      for (auto itNote = notes.first; itNote != notes.second; ++itNote) {
+        auto & note = * itNote;
+        if (int64_t(note.nStartTime) + note.nDuration < nWindowStart) continue;
+        float x0 = (float(note.nStartTime) - nTrackOffset) / nTimePerColumn;
+        float x1 = x0 + std::max(1.0f, float(note.nDuration) / nTimePerColumn);
+        float y0 = fOffsetY + float((nNoteRange - (note.nKey - track.nMinNote)) * nNoteHeight);
+        AddQuad(x0, y0, x1, y0 + float(nNoteHeight), NoteColour(nTrack, note.nChannel, note.nVelocity));
+      }
+    }
+    for (size_t i: vecSoundingNotes[nTrack]) {
+      auto & note = track.vecNotes[i];
+      float x0 = (float(note.nStartTime) - nTrackOffset) / nTimePerColumn;
+      float y0 = fOffsetY + float((nNoteRange - (note.nKey - track.nMinNote)) * nNoteHeight);
+      AddQuad(x0, y0, x0 + std::max(1.0f, float(note.nDuration) / nTimePerColumn), y0 + float(nNoteHeight), olc::YELLOW);
+    }
+    if (vecQuadPos.empty()) return;
+
+    vecQuadUV.resize(vecQuadPos.size());
+    SetDecalStructure(olc::DecalStructure::LIST);
+    DrawPolygonDecal(nullptr, vecQuadPos, vecQuadUV, vecQuadCol);
+    SetDecalStructure(olc::DecalStructure::FAN);
+  }
+
+  // Scope timings, shown with P and written to profile.csv and profile.json
+  // with F9. "present" is the time the engine spends between two updates,
+  // putting the last frame on screen, polling input and waiting out the
+  // frame cap. Gaps with idle frames skipped are left out.
+  Profiler profiler;
+  bool bProfilerOverlay = false;
+  uint64_t nLastUpdateEnd = 0;
+  uint64_t nLastSkipped = 0;
+
+  bool OnUserUpdate(float fElapsedTime) override {
+    if (nLastUpdateEnd != 0 && GetFrameStats().nSkipped == nLastSkipped) profiler.Record("present", nLastUpdateEnd, profiler.Now() - nLastUpdateEnd);
+    nLastSkipped = GetFrameStats().nSkipped;
+    bool bContinue;
+    {
+      Profiler::Scope scope(profiler, "update");
+      bContinue = UpdateFrame(fElapsedTime);
+    }
+    if (bProfilerOverlay) {
+      Profiler::Scope scope(profiler, "overlay");
+      DrawProfilerOverlay();
+    }
+    profiler.EndFrame();
+    nLastUpdateEnd = profiler.Now();
+
+    // Playback and the overlay's own numbers change every frame
+    if (bPlaying || bProfilerOverlay) RequestRedraw();
+    return bContinue;
+  }
+
+  void DrawProfilerOverlay() {
+    auto & vecStats = profiler.Stats();
+    int32_t nWidth = 8 * 20 + 4;
+    int32_t x = ScreenWidth() - nWidth;
+    FillRect(x, 0, nWidth, int32_t(vecStats.size() + 2) * 10 + 4, olc::VERY_DARK_BLUE);
+    DrawString(x + 2, 2, "fps " + std::to_string(GetFPS()), olc::WHITE);
+    char sLine[32];
+    std::snprintf(sLine, sizeof(sLine), "%-10.10s%7.2fms", "jitter", GetFrameStats().fJitter * 1000.0f);
+    DrawString(x + 2, 12, sLine, olc::WHITE);
+    for (size_t i = 0; i < vecStats.size(); i++) {
+      std::snprintf(sLine, sizeof(sLine), "%-10.10s%7.2fms", vecStats[i].sName, vecStats[i].dAverage);
+      DrawString(x + 2, int32_t(i + 2) * 10 + 2, sLine, olc::WHITE);
+    }
+  }
+
+  bool UpdateFrame(float fElapsedTime) {
+    // Files dropped on the window replace the current one
+    if (!GetDroppedFiles().empty()) StartLoading(GetDroppedFiles().front());
+    PollLoader();
+
+    // SPACE plays/pauses, HOME rewinds, ENTER moves the playhead into view,
+    // LEFT/RIGHT scroll while paused, C cycles note colours. The wheel zooms
+    // time around the mouse, SHIFT+wheel zooms pitch, CTRL+wheel and
+    // UP/DOWN/PGUP/PGDN scroll tracks.
+    if (GetKey(olc::Key::SPACE).bPressed) {
+      bPlaying = !bPlaying;
+      Seek(dSongTime);
+    }
+    if (GetKey(olc::Key::HOME).bPressed) {
+      Seek(0.0);
+      nLastScrollX = INT32_MIN;
+    }
+    if (GetKey(olc::Key::ENTER).bPressed) {
+      Seek(pSong -> midi.TickToSeconds(std::max(0.0f, nTrackOffset + float(ScreenWidth() / 4) * nTimePerColumn)));
+      nLastScrollX = INT32_MIN;
+    }
+    if (bPlaying) AdvancePlayback();
+    else {
+      if (GetKey(olc::Key::LEFT).bHeld) nTrackOffset -= 10000.0f * fElapsedTime;
+      if (GetKey(olc::Key::RIGHT).bHeld) nTrackOffset += 10000.0f * fElapsedTime;
+    }
+    if (GetKey(olc::Key::G).bPressed && bDecalAvailable) {
+      bDecalNotes = !bDecalNotes;
+      nLastScrollX = INT32_MIN;
+    }
+    if (GetKey(olc::Key::C).bPressed) {
+      colourMode = NoteColours((int(colourMode) + 1) % 3);
+      BakePalette();
+    }
+    if (GetKey(olc::Key::P).bPressed) {
+      bProfilerOverlay = !bProfilerOverlay;
+      nLastScrollX = INT32_MIN;
+    }
+    if (GetKey(olc::Key::F9).bPressed) {
+      profiler.WriteCSV("profile.csv");
+      profiler.WriteChromeTrace("profile.json");
+    }
+
+    int32_t nWheel = GetMouseWheel();
+    if (nWheel != 0 && GetKey(olc::Key::CTRL).bHeld) {
+      ScrollBy(nWheel > 0 ? -48.0f : 48.0f);
+    } else if (nWheel != 0 && GetKey(olc::Key::SHIFT).bHeld) {
+      nNoteHeight = nWheel > 0 ? std::min(nNoteHeight + 1, 16u) : std::max(nNoteHeight - 1, 1u);
+    } else if (nWheel != 0) {
+      // Keep the tick under the mouse where it is
+      float fMouseTick = nTrackOffset + float(GetMouseX()) * nTimePerColumn;
+      nTimePerColumn = nWheel > 0 ? std::max(nTimePerColumn * 4 / 5, 1u) : std::min(nTimePerColumn * 5 / 4 + 1, 65536u);
+      nTrackOffset = fMouseTick - float(GetMouseX()) * nTimePerColumn;
+      if (bPlaying) FollowPlayhead();
+    }
+    if (GetKey(olc::Key::UP).bHeld) ScrollBy(-600.0f * fElapsedTime);
+    if (GetKey(olc::Key::DOWN).bHeld) ScrollBy(600.0f * fElapsedTime);
+    if (GetKey(olc::Key::PGUP).bPressed) ScrollBy(-float(ScreenHeight()));
+    if (GetKey(olc::Key::PGDN).bPressed) ScrollBy(float(ScreenHeight()));
+
+    UpdateLayout();
+    int32_t nScrollY = int32_t(fScrollY);
+
+    // Decals are gone after every frame so have to be resubmitted, but the
+    // sprite layer underneath only holds the track backgrounds and names
+    if (bDecalNotes) {
+      bool bLayout = nLastScrollX == INT32_MIN || nScrollY != nLastScrollY || bProfilerOverlay;
+      nLastScrollX = 0;
+      nLastScrollY = nScrollY;
+      if (bLayout) Clear(olc::BLACK);
+      auto tracks = VisibleTracks(nScrollY);
+      for (size_t t = tracks.first; t < tracks.second; t++) {
+        auto & track = * pSong -> vecTracks[t];
+        if (!track.vecNotes.empty()) {
+          int32_t nOffsetY = vecTrackY[t] - nScrollY;
+          if (bLayout) {
+            FillRect(0, nOffsetY, ScreenWidth(), TrackHeight(t), olc::DARK_GREY);
+            Profiler::Scope scope(profiler, "text");
+            DrawString(1, nOffsetY + 1, track.sName);
+          }
+          Profiler::Scope scope(profiler, "notes");
+          DrawTrackDecal(t, float(nOffsetY));
+        }
+      }
+      if (bLayout) DrawLoadStatus();
+      FillRectDecal({ PlayheadX(), 0.0f }, { 1.0f, float(ScreenHeight()) }, olc::RED);
+      return true;
+    }
+
+    // Nothing on screen can have changed unless the roll moved a whole pixel
+    // or notes are starting and stopping under the playhead
+    int32_t nScrollX = int32_t(std::floor(nTrackOffset / nTimePerColumn));
+    if (nScrollX == nLastScrollX && nScrollY == nLastScrollY && !bPlaying && !bProfilerOverlay) return true;
+    nLastScrollX = nScrollX;
+    nLastScrollY = nScrollY;
+    DrawRoll();
+    DrawLoadStatus();
+    return true;
+  }
+
+  // Tiles hold a track's full height at one zoom, so either zoom throws
+  // them away, while tracks arriving from the loader leave the rest valid
+  void UpdateLayout() {
+    if (nLayoutNoteHeight != nNoteHeight) {
+      vecTileCache.clear();
+      nLastScrollX = INT32_MIN;
+    }
+    if (nLayoutNoteHeight != nNoteHeight || vecTrackY.size() != pSong -> vecTracks.size()) Layout();
+    if (nCachedTimePerColumn != nTimePerColumn) {
+      vecTileCache.clear();
+      nCachedTimePerColumn = nTimePerColumn;
+      nLastScrollX = INT32_MIN;
+    }
+    vecTileCache.resize(pSong -> vecTracks.size());
+  }
+
+  // Composes a frame from the tile cache into the current draw target
+  void DrawRoll() {
+    int32_t nScrollX = int32_t(std::floor(nTrackOffset / nTimePerColumn));
+    Clear(olc::BLACK);
+    int32_t nFirstTile = int32_t(std::floor(float(nScrollX) / nTileWidth));
+    int32_t nLastTile = int32_t(std::floor(float(nScrollX + ScreenWidth()) / nTileWidth));
+    int32_t nScrollY = int32_t(fScrollY);
+
+    auto tracks = VisibleTracks(nScrollY);
+    {
+      Profiler::Scope scope(profiler, "notes");
+      for (size_t t = tracks.first; t < tracks.second; t++) {
+        auto & track = * pSong -> vecTracks[t];
+        auto & mapTiles = vecTileCache[t];
+        if (!track.vecNotes.empty()) {
+          uint32_t nNoteRange = track.nMaxNote - track.nMinNote;
+          int32_t nTrackHeight = TrackHeight(t);
+          int32_t nOffsetY = vecTrackY[t] - nScrollY;
+
+          for (int32_t nTile = nFirstTile; nTile <= nLastTile; nTile++) {
+            auto & pTile = mapTiles[nTile];
+            if (!pTile) {
+              pTile = std::make_unique < olc::Sprite > (nTileWidth, nTrackHeight);
+              DrawTile(t, nTile, pTile.get());
+            }
+            DrawSprite(nTile * nTileWidth - nScrollX, nOffsetY, pTile.get());
+          }
+
+          // Drop tiles that have scrolled well out of view
+          mapTiles.erase(mapTiles.begin(), mapTiles.lower_bound(nFirstTile - 1));
+          mapTiles.erase(mapTiles.upper_bound(nLastTile + 1), mapTiles.end());
+
+          for (size_t i: vecSoundingNotes[t]) {
+            auto & note = track.vecNotes[i];
+            FillRect(int32_t(note.nStartTime / nTimePerColumn) - nScrollX, int32_t((nNoteRange - (note.nKey - track.nMinNote)) * nNoteHeight) + nOffsetY, std::max < int32_t > (1, note.nDuration / nTimePerColumn), nNoteHeight, olc::YELLOW);
+          }
+        }
+      }
+    }
+
+    {
+      Profiler::Scope scope(profiler, "text");
+      for (size_t t = tracks.first; t < tracks.second; t++)
+        if (!pSong -> vecTracks[t] -> vecNotes.empty()) DrawString(1, vecTrackY[t] - nScrollY + 1, pSong -> vecTracks[t] -> sName);
+    }
+    DrawLine(int32_t(PlayheadX()), 0, int32_t(PlayheadX()), ScreenHeight() - 1, olc::RED);
+  }
+
+  /* Draws the roll as it looks dTime seconds into the song into pFrame, which
+   * must be ScreenWidth() x ScreenHeight(). Needs neither a window nor Start(),
+   * only Construct() and olc_ConstructFontSheet(), so offscreen renderers can
+   * call this from their own threads. Tiles stay cached between calls, so
+   * frames in time order only draw the strip that scrolled into view.
+   */
+  void RenderFrame(double dTime, olc::Sprite * pFrame) {
+    Seek(dTime);
+    FollowPlayhead();
+    UpdateLayout();
+
+    olc::Sprite * pTarget = GetDrawTarget();
+    SetDrawTarget(pFrame);
+    DrawRoll();
+    FlushCommands();
+    SetDrawTarget(pTarget);
+  }
+};
@@ -410,9 +410,14 @@ int main()
 #include <list>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <memory>
 #include <functional>
+#include <type_traits>
 #include <algorithm>
 #include <array>
 #include <cstring>
@@ -460,6 +465,13 @@ int main()
 
 #define UNUSED(x) (void)(x)
 
+// SSE2 is part of every x86-64 target, and is used to fill and blend whole
+// rows of pixels at a time. Define OLC_NO_SIMD to use the scalar paths only.
+#if !defined(OLC_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define OLC_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
 // O------------------------------------------------------------------------------O
 // | PLATFORM SELECTION CODE, Thanks slavka!                                      |
 // O------------------------------------------------------------------------------O
@@ -576,6 +588,19 @@ int main()
 #endif
 #endif
 
+// Resource packs are memory mapped where the platform allows it
+#if defined(_WIN32)
+	#if !defined(NOMINMAX)
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 #if defined(OLC_PGE_HEADLESS)
 #if defined max
 #undef max
@@ -1008,9 +1033,21 @@ namespace olc
 	struct ResourceBuffer : public std::streambuf
 	{
 		ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size);
+		ResourceBuffer(std::vector<char> vData);
 		std::vector<char> vMemory;
 	};
 
+	// A file's bytes in place inside a loaded pack, valid until the pack is
+	// reloaded or destroyed. pData is nullptr when there is no such span.
+	struct ResourceSpan
+	{
+		const uint8_t* pData = nullptr;
+		size_t nSize = 0;
+	};
+
+	// Version 2 packs are memory mapped, find files through a hash table in
+	// O(1), keep a CRC32 of every file, and may store files LZ4 compressed.
+	// Version 1 packs are still read, and still written on request.
 	class ResourcePack : public std::streambuf
 	{
 	public:
@@ -1018,15 +1055,66 @@ namespace olc
 		~ResourcePack();
 		bool AddFile(const std::string& sFile);
 		bool LoadPack(const std::string& sFile, const std::string& sKey);
-		bool SavePack(const std::string& sFile, const std::string& sKey);
+		// bCompress stores a file compressed where that saves an eighth or more
+		bool SavePack(const std::string& sFile, const std::string& sKey, uint32_t nVersion = 2, bool bCompress = false);
+		// A copy of the file, decompressed and checked against its CRC32. Empty
+		// if the file is missing or corrupt.
 		ResourceBuffer GetFileBuffer(const std::string& sFile);
+		// The file with no copy and no check, for files stored uncompressed
+		ResourceSpan GetFileSpan(const std::string& sFile) const;
+		// Checks one file, or every file if sFile is empty, against its CRC32.
+		// Version 1 packs have no checksums, so only the bounds are checked.
+		bool Verify(const std::string& sFile = "") const;
 		bool Loaded();
 	private:
 		struct sResourceFile { uint32_t nSize; uint32_t nOffset; };
-		std::map<std::string, sResourceFile> mapFiles;
-		std::ifstream baseFile;
-		std::vector<char> scramble(const std::vector<char>& data, const std::string& key);
-		std::string makeposix(const std::string& path);
+		std::map<std::string, sResourceFile> mapFiles;		// Files added for saving
+
+		// Read only view of the whole pack file
+		struct MappedFile
+		{
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile() { Close(); }
+			bool Open(const std::string& sFile);
+			void Close();
+			const uint8_t* pData = nullptr;
+			size_t nSize = 0;
+		private:
+#if defined(_WIN32)
+			HANDLE hFile = INVALID_HANDLE_VALUE;
+			HANDLE hMapping = nullptr;
+#endif
+			bool bMapped = false;
+			std::vector<uint8_t> vFallback;				// Whole file, where it cannot be mapped
+		} mapped;
+
+		// Loaded index of either version
+		struct sEntry
+		{
+			uint64_t nOffset;
+			uint32_t nStoredSize, nSize, nCrc, nHash, nName, nNameSize;
+			uint8_t nCompression;						// 0 = stored, 1 = LZ4 block
+		};
+		std::vector<sEntry> vecEntries;
+		std::vector<uint32_t> vecSlots;					// Entry + 1, 0 for an empty slot
+		std::string sNames;
+		bool bChecksums = false;
+
+		bool loadv1(const std::string& sKey);
+		bool loadv2(const std::string& sKey);
+		bool savev1(const std::string& sFile, const std::string& sKey);
+		bool savev2(const std::string& sFile, const std::string& sKey, bool bCompress);
+		static std::vector<uint32_t> buildslots(const std::vector<sEntry>& entries);
+		const sEntry* find(const std::string& sFile) const;
+		bool read(const sEntry& e, std::vector<char>& vOut) const;
+		static uint32_t hash(const char* data, size_t size);
+		static uint32_t crc32(const uint8_t* data, size_t size);
+		static void compress(const std::vector<char>& vIn, std::vector<char>& vOut);
+		static bool decompress(const uint8_t* src, size_t nSrc, uint8_t* dst, size_t nDst);
+		static std::vector<char> scramble(const std::vector<char>& data, const std::string& key);
+		static std::string makeposix(const std::string& path);
 	};
 
 
@@ -1071,6 +1159,13 @@ namespace olc
 		Pixel Sample(const olc::vf2d& uv) const;
 		Pixel SampleBL(float u, float v) const;
 		Pixel SampleBL(const olc::vf2d& uv) const;
+		// Batches of samples, either n arbitrary UVs or a row of n starting
+		// at uv and stepping by duv. See the implementation for how these
+		// differ from one Sample() or SampleBL() per pixel.
+		void Sample(const olc::vf2d* pUV, Pixel* pOut, size_t n) const;
+		void SampleBL(const olc::vf2d* pUV, Pixel* pOut, size_t n) const;
+		void SampleSpan(const olc::vf2d& uv, const olc::vf2d& duv, Pixel* pOut, size_t n) const;
+		void SampleSpanBL(const olc::vf2d& uv, const olc::vf2d& duv, Pixel* pOut, size_t n) const;
 		Pixel* GetData();
 		olc::Sprite* Duplicate();
 		olc::Sprite* Duplicate(const olc::vi2d& vPos, const olc::vi2d& vSize);
@@ -1158,12 +1253,35 @@ namespace olc
 		bool depth = false;
 	};
 
+	// Frame timing as seen by the engine loop, all times in seconds. Moving
+	// averages weight the latest frame by 1/20.
+	struct FrameStats
+	{
+		uint64_t nFrames = 0;		// Frames drawn
+		uint64_t nSkipped = 0;		// Idle frames skipped in redraw-on-change mode
+		float fInterval = 0.0f;		// Last time from one drawn frame to the next
+		float fAverage = 0.0f;		// Moving average of fInterval
+		float fJitter = 0.0f;		// Moving average of |fInterval - target|, the target being the cap if set, else fAverage
+		float fWorst = 0.0f;		// Longest fInterval over the last whole second
+		float fWork = 0.0f;			// Moving average of time spent on a frame, leaving out the pacing wait
+	};
+
+	// The parts of a layer drawn on since it was last uploaded, kept as a few
+	// rectangles that merge as they grow
+	struct DirtyRegion
+	{
+		static constexpr size_t nMaxRects = 8;
+		std::vector<std::pair<olc::vi2d, olc::vi2d>> vecRects; // Top left, bottom right (exclusive)
+		void Add(const olc::vi2d& tl, const olc::vi2d& br);
+	};
+
 	struct LayerDesc
 	{
 		olc::vf2d vOffset = { 0, 0 };
 		olc::vf2d vScale = { 1, 1 };
 		bool bShow = false;
-		bool bUpdate = false;
+		bool bUpdate = false;	// Upload the whole layer, not just its dirty region
+		DirtyRegion dirty;
 		olc::Renderable pDrawTarget;
 		uint32_t nResID = 0;
 		std::vector<DecalInstance> vecDecalInstance;
@@ -1185,11 +1303,17 @@ namespace olc
 		virtual void       DrawDecal(const olc::DecalInstance& decal) = 0;
 		virtual uint32_t   CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) = 0;
 		virtual void       UpdateTexture(uint32_t id, olc::Sprite* spr) = 0;
+		// Uploads the area pos to pos + size of a sprite to its texture, which is
+		// already the sprite's size. Returns false if the renderer cannot, and the
+		// caller then uploads the whole sprite once instead.
+		virtual bool       UpdateTextureRegion(uint32_t, olc::Sprite*, const olc::vi2d&, const olc::vi2d&) { return false; }
 		virtual void       ReadTexture(uint32_t id, olc::Sprite* spr) = 0;
 		virtual uint32_t   DeleteTexture(const uint32_t id) = 0;
 		virtual void       ApplyTexture(uint32_t id) = 0;
 		virtual void       UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) = 0;
 		virtual void       ClearBuffer(olc::Pixel p, bool bDepth) = 0;
+		// The finished frame, for renderers that draw into memory
+		virtual const olc::Sprite* GetFrameBuffer() const { return nullptr; }
 		static olc::PixelGameEngine* ptrPGE;
 	};
 
@@ -1213,6 +1337,18 @@ namespace olc
 
 	class PGEX;
 
+	// The row writers for one pixel mode. Primitives pick these once per call,
+	// instead of testing the pixel mode for every pixel they plot.
+	struct SpanBlitter
+	{
+		// Writes one colour over n pixels
+		void (*Fill)(Pixel* pDst, int32_t n, Pixel p, uint32_t nBlend) = nullptr;
+		// Writes n source pixels over n pixels
+		void (*Copy)(Pixel* pDst, const Pixel* pSrc, int32_t n, uint32_t nBlend) = nullptr;
+		// Blend factor as 0..255
+		uint32_t nBlend = 255;
+	};
+
 	// The Static Twins (plus one)
 	static std::unique_ptr<Renderer> renderer;
 	static std::unique_ptr<Platform> platform;
@@ -1289,6 +1425,26 @@ namespace olc
 		uint32_t GetFPS() const;
 		// Gets last update of elapsed time
 		float GetElapsedTime() const;
+		// Caps the frame rate at fFPS, 0 for uncapped. Waits sleep until
+		// fSpin seconds before the next frame is due and spin the rest, as
+		// a sleep can overrun by a scheduler tick.
+		void SetFrameCap(float fFPS, float fSpin = 0.002f);
+		// Only updates and presents a frame when there is input, the window
+		// resizes or RequestRedraw() was called, and at least every fMaxIdle
+		// seconds. The first frame after skipped ones gets at most one poll
+		// period, the frame cap or 1/60s, as fElapsedTime.
+		void SetRedrawOnChange(bool bEnable, float fMaxIdle = 0.5f);
+		// Asks for another frame in redraw-on-change mode, from any thread
+		void RequestRedraw();
+		// Frame timing and jitter, updated as frames are drawn
+		const FrameStats& GetFrameStats() const;
+		// Called with each finished frame when the renderer draws into
+		// memory, as the headless one does. The sprite is the renderer's own
+		// frame, valid until the callback returns.
+		void SetFrameCallback(std::function<void(const olc::Sprite&)> f);
+		// The last finished frame until the next one starts, or nullptr if
+		// frames only exist on the GPU
+		const olc::Sprite* GetFrameBuffer() const;
 		// Gets Actual Window size
 		const olc::vi2d& GetWindowSize() const;
 		// Gets Actual Window position
@@ -1313,6 +1469,10 @@ namespace olc
 		void SetLayerScale(uint8_t layer, float x, float y);
 		void SetLayerTint(uint8_t layer, const olc::Pixel& tint);
 		void SetLayerCustomRenderFunction(uint8_t layer, std::function<void()> f);
+		// Drawing routines track which parts of a layer they change, and only
+		// those are uploaded at the end of the frame. Pixels written straight
+		// into a layer's sprite must be marked here to be uploaded.
+		void MarkLayerDirty(uint8_t layer, const olc::vi2d& pos, const olc::vi2d& size);
 
 		std::vector<LayerDesc>& GetLayers();
 		uint32_t CreateLayer();
@@ -1327,6 +1487,8 @@ namespace olc
 		void SetPixelMode(std::function<olc::Pixel(const int x, const int y, const olc::Pixel& pSource, const olc::Pixel& pDest)> pixelMode);
 		// Change the blend factor from between 0.0f to 1.0f;
 		void SetPixelBlend(float fBlend);
+		// Span writers for the current pixel mode; both are null in CUSTOM mode
+		SpanBlitter GetSpanBlitter() const;
 
 		// [ADVANCED] For those that really want to dick about with PGE :P
 		// Note: Normal use of olc::PGE does not require you use these functions
@@ -1379,6 +1541,17 @@ namespace olc
 		void DrawStringProp(const olc::vi2d& pos, const std::string& sText, Pixel col = olc::WHITE, uint32_t scale = 1);
 		olc::vi2d GetTextSizeProp(const std::string& s);
 
+		// Command buffer. While enabled, FillRect, DrawRect, DrawLine, DrawSprite,
+		// DrawPartialSprite, DrawString, DrawStringProp and Clear are recorded
+		// instead of drawn. Recorded calls are rasterized by FlushCommands(), or at
+		// the end of the frame, with the target cut into horizontal tiles that
+		// nThreads workers (0 = one per core) share out. The output is identical to
+		// drawing directly. Anything else drawn, and anything drawn in CUSTOM pixel
+		// mode, flushes first and is then drawn straight away. Read the draw target
+		// only after a flush.
+		void EnableCommandBuffer(bool bEnable, uint32_t nThreads = 0);
+		void FlushCommands();
+
 		// Decal Quad functions
 		void SetDecalMode(const olc::DecalMode& mode);
 		void SetDecalStructure(const olc::DecalStructure& structure);
@@ -1491,6 +1664,7 @@ namespace olc
 		olc::Sprite*     pDrawTarget = nullptr;
 		Pixel::Mode	nPixelMode = Pixel::NORMAL;
 		float		fBlendFactor = 1.0f;
+		uint32_t	nBlendFactor = 255;
 		olc::vi2d	vScreenSize = { 256, 240 };
 		olc::vf2d	vInvScreenSize = { 1.0f / 256.0f, 1.0f / 240.0f };
 		olc::vi2d	vPixelSize = { 4, 4 };
@@ -1525,13 +1699,95 @@ namespace olc
 		DecalMode   nDecalMode = DecalMode::NORMAL;
 		DecalStructure nDecalStructure = DecalStructure::FAN;
 		std::function<olc::Pixel(const int x, const int y, const olc::Pixel&, const olc::Pixel&)> funcPixelMode;
-		std::chrono::time_point<std::chrono::system_clock> m_tp1, m_tp2;
+		std::chrono::time_point<std::chrono::steady_clock> m_tp1, m_tp2;
+		// Frame pacing
+		float		fFrameCap = 0.0f;		// Seconds per frame, 0 for uncapped
+		float		fFrameSpin = 0.002f;
+		bool		bRedrawOnChange = false;
+		float		fMaxIdle = 0.5f;
+		std::atomic<bool> bRedrawRequested{ true };
+		std::chrono::time_point<std::chrono::steady_clock> tpNextFrame, tpLastDrawn;
+		FrameStats	frameStats;
+		std::function<void(const olc::Sprite&)> funcFrameCallback;
+		uint64_t	nStatsSkipped = 0;
+		float		fWorstThisSecond = 0.0f;
+		bool olc_InputChanged() const;
+		void olc_PaceFrame(float fPeriod, float fSpin);
 		std::vector<olc::vi2d> vFontSpacing;
 		std::vector<std::string> vDroppedFiles;
 		std::vector<std::string> vDroppedFilesCache;
 		olc::vi2d vDroppedFilesPoint;
 		olc::vi2d vDroppedFilesPointCache;
 
+		// Layer whose sprite is the draw target, or -1
+		int32_t nDirtyLayer = -1;
+		void olc_UpdateDirtyLayer();
+		// Marks x1,y1 to x2,y2 (exclusive) of the draw target as changed
+		void olc_MarkDirty(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+
+		// Fills the pixels x1..x2 inclusive of row y, clipped to the target
+		void FillSpan(const SpanBlitter& blit, int32_t x1, int32_t x2, int32_t y, Pixel p);
+
+		// Text Rendering Specific
+		struct TextRun { int32_t x, y, n; };	// n pixels from (x,y), relative to the text's origin
+		struct TextRuns
+		{
+			std::vector<TextRun> vecRuns;
+			int32_t nTop = 0, nBottom = -1;	// Rows used, inclusive
+			int32_t nLeft = 0, nRight = -1;	// Columns used, inclusive
+		};
+		static constexpr size_t nTextRunsCacheSize = 4096;
+		std::array<uint8_t, 96 * 8> nGlyphRows{};	// Per glyph row, bit i set where column i is drawn
+		std::unordered_map<std::string, std::shared_ptr<const TextRuns>> mapTextRuns;
+		std::string sTextRunsKey;
+		void olc_DrawText(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale, bool bProp);
+		void olc_DrawTextPixels(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale, bool bProp);
+		std::shared_ptr<const TextRuns> olc_GetTextRuns(const std::string& sText, uint32_t scale, bool bProp);
+		static void olc_FillTextRuns(Sprite* pTarget, int32_t x, int32_t y, const TextRuns& runs, Pixel col, const SpanBlitter& blit, int32_t y0, int32_t y1);
+
+		// Command Buffer Specific
+		struct DrawCommand
+		{
+			enum class Type : uint8_t { FillRect, Line, Sprite, Text } type;
+			olc::Sprite* pTarget = nullptr;
+			Pixel::Mode nMode = Pixel::NORMAL;
+			uint32_t nBlend = 255;
+			Pixel p;
+			int32_t x1 = 0, y1 = 0, x2 = 0, y2 = 0;	// Rect corners, line ends, or sprite/text position
+			const olc::Sprite* pSprite = nullptr;
+			int32_t ox = 0, oy = 0, w = 0, h = 0;	// Sprite source area
+			uint32_t nParam = 1;	// Line pattern, or sprite scale
+			uint8_t nFlip = 0;
+			std::shared_ptr<const TextRuns> pText;
+			int32_t nTop = 0, nBottom = -1;	// Rows touched, inclusive
+		};
+		static constexpr int32_t nCommandTileHeight = 32;
+		bool bCommandBuffer = false;
+		uint32_t nRasterThreads = 1;
+		std::vector<DrawCommand> vecCommands;
+		std::vector<const olc::Sprite*> vecCommandTargets;
+		std::vector<const olc::Sprite*> vecCommandSources;
+		std::vector<std::vector<uint32_t>> vecTileCommands;
+		std::atomic<size_t> nNextTile{ 0 };
+		std::vector<std::thread> vecRasterWorkers;
+		std::mutex muxRaster;
+		std::condition_variable cvRasterWork, cvRasterDone;
+		uint64_t nRasterBatch = 0;
+		uint32_t nRasterBusy = 0;
+		bool bRasterQuit = false;
+
+		bool olc_RecordCommand(const olc::Sprite* pSource = nullptr, bool bUsesPixelMode = true);
+		void olc_RasterTiles();
+		void olc_RasterCommand(const DrawCommand& cmd, int32_t y0, int32_t y1);
+		void olc_RasterWorker(uint64_t nSeen);
+		void olc_StopRasterWorkers();
+		// Primitives shared by direct drawing and tiled rasterization, which
+		// differ only in how each pixel is plotted
+		template<typename PLOT> void olc_RasterLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern, PLOT&& plot);
+		static bool olc_BlitSprite(Sprite* pTarget, int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip, const SpanBlitter& blit, int32_t y0, int32_t y1);
+		template<typename PLOT> void olc_RasterSprite(int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip, PLOT&& plot);
+
+
 		// Command Console Specific
 		bool bConsoleShow = false;
 		bool bConsoleSuspendTime = false;
@@ -1956,6 +2212,152 @@ namespace olc
 		return SampleBL(uv.x, uv.y);
 	}
 
+	// Batch sampling kernels, with the sprite's sample mode as a template
+	// argument so the per-texel addressing does not branch on it. Bilinear
+	// weights are 8 bit fixed point, and the scalar and SSE2 paths give
+	// identical results.
+	namespace sample
+	{
+		// GetPixel() for one sample mode
+		template<Sprite::Mode M> inline Pixel Texel(const Sprite* s, int32_t x, int32_t y)
+		{
+			if (M == Sprite::Mode::NORMAL)
+				return (x >= 0 && x < s->width && y >= 0 && y < s->height) ? s->pColData[size_t(y) * s->width + x] : Pixel(0, 0, 0, 0);
+			else if (M == Sprite::Mode::PERIODIC)
+				return s->pColData[size_t(std::abs(y % s->height)) * s->width + std::abs(x % s->width)];
+			else
+				return s->pColData[size_t(std::max(0, std::min(y, s->height - 1))) * s->width + std::max(0, std::min(x, s->width - 1))];
+		}
+
+		// p1 p2 over p3 p4, blended by fx and fy in 1/256ths of a texel,
+		// rounding down after each direction
+		inline Pixel Blend(Pixel p1, Pixel p2, Pixel p3, Pixel p4, uint32_t fx, uint32_t fy)
+		{
+#if defined(OLC_SIMD_SSE2)
+			const __m128i vZero = _mm_setzero_si128();
+			__m128i vWx = _mm_unpacklo_epi64(_mm_set1_epi16(int16_t(256 - fx)), _mm_set1_epi16(int16_t(fx)));
+			__m128i vWy = _mm_unpacklo_epi64(_mm_set1_epi16(int16_t(256 - fy)), _mm_set1_epi16(int16_t(fy)));
+			__m128i vTop = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set_epi32(0, 0, int32_t(p2.n), int32_t(p1.n)), vZero), vWx);
+			__m128i vBot = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_set_epi32(0, 0, int32_t(p4.n), int32_t(p3.n)), vZero), vWx);
+			vTop = _mm_add_epi16(vTop, _mm_srli_si128(vTop, 8));
+			vBot = _mm_add_epi16(vBot, _mm_srli_si128(vBot, 8));
+			__m128i v = _mm_mullo_epi16(_mm_srli_epi16(_mm_unpacklo_epi64(vTop, vBot), 8), vWy);
+			v = _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_si128(v, 8)), 8);
+			Pixel p;
+			p.n = uint32_t(_mm_cvtsi128_si32(_mm_packus_epi16(v, vZero)));
+			return p;
+#else
+			auto Lerp = [](uint32_t a, uint32_t b, uint32_t f) { return (a * (256 - f) + b * f) >> 8; };
+			uint32_t n = 0;
+			for (uint32_t k = 0; k < 32; k += 8)
+			{
+				uint32_t t = Lerp((p1.n >> k) & 0xFF, (p2.n >> k) & 0xFF, fx);
+				uint32_t b = Lerp((p3.n >> k) & 0xFF, (p4.n >> k) & 0xFF, fx);
+				n |= Lerp(t, b, fy) << k;
+			}
+			Pixel p;
+			p.n = n;
+			return p;
+#endif
+		}
+
+		// The four texels SampleBL() reads around (x, y), blended
+		template<Sprite::Mode M> inline Pixel Bilinear(const Sprite* s, int32_t x, int32_t y, uint32_t fx, uint32_t fy)
+		{
+			if (x >= 0 && x + 1 < s->width && y >= 0 && y + 1 < s->height)
+			{
+				const Pixel* p = &s->pColData[size_t(y) * s->width + x];
+				return Blend(p[0], p[1], p[s->width], p[s->width + 1], fx, fy);
+			}
+			int32_t x0 = std::max(x, 0), x1 = std::min(x + 1, s->width - 1);
+			int32_t y0 = std::max(y, 0), y1 = std::min(y + 1, s->height - 1);
+			return Blend(Texel<M>(s, x0, y0), Texel<M>(s, x1, y0), Texel<M>(s, x0, y1), Texel<M>(s, x1, y1), fx, fy);
+		}
+
+		// One sample per UV, texel positions worked out in float exactly as
+		// Sample() and SampleBL() do
+		template<Sprite::Mode M, bool BL> inline void Points(const Sprite* s, const olc::vf2d* pUV, Pixel* pOut, size_t n)
+		{
+			float fw = float(s->width), fh = float(s->height);
+			for (size_t i = 0; i < n; i++)
+			{
+				if (BL)
+				{
+					float u = pUV[i].x * fw - 0.5f, v = pUV[i].y * fh - 0.5f;
+					float x = std::floor(u), y = std::floor(v);
+					pOut[i] = Bilinear<M>(s, int32_t(x), int32_t(y), uint32_t((u - x) * 256.0f), uint32_t((v - y) * 256.0f));
+				}
+				else
+					pOut[i] = Texel<M>(s, std::min(int32_t(pUV[i].x * fw), s->width - 1), std::min(int32_t(pUV[i].y * fh), s->height - 1));
+			}
+		}
+
+		// A row of samples stepped in 16.16 fixed point texels, so there is
+		// no float work per sample
+		template<Sprite::Mode M, bool BL> inline void Span(const Sprite* s, const olc::vf2d& uv, const olc::vf2d& duv, Pixel* pOut, size_t n)
+		{
+			float fw = float(s->width), fh = float(s->height);
+			float fBias = BL ? 0.5f : 0.0f;
+			int64_t u = std::llround((double(uv.x) * fw - fBias) * 65536.0), du = std::llround(double(duv.x) * fw * 65536.0);
+			int64_t v = std::llround((double(uv.y) * fh - fBias) * 65536.0), dv = std::llround(double(duv.y) * fh * 65536.0);
+			for (size_t i = 0; i < n; i++, u += du, v += dv)
+			{
+				if (BL)
+					pOut[i] = Bilinear<M>(s, int32_t(u >> 16), int32_t(v >> 16), uint32_t(u >> 8) & 0xFF, uint32_t(v >> 8) & 0xFF);
+				else
+				{
+					// Sample() rounds towards zero
+					int32_t x = int32_t(u < 0 ? -(-u >> 16) : u >> 16), y = int32_t(v < 0 ? -(-v >> 16) : v >> 16);
+					pOut[i] = Texel<M>(s, std::min(x, s->width - 1), std::min(y, s->height - 1));
+				}
+			}
+		}
+
+		template<typename F> inline void ForMode(const Sprite* s, Pixel* pOut, size_t n, F&& f)
+		{
+			if (s->width <= 0 || s->height <= 0)
+			{
+				std::fill(pOut, pOut + n, Pixel(0, 0, 0, 0));
+				return;
+			}
+			switch (s->modeSample)
+			{
+			case Sprite::Mode::NORMAL: f(std::integral_constant<Sprite::Mode, Sprite::Mode::NORMAL>()); break;
+			case Sprite::Mode::PERIODIC: f(std::integral_constant<Sprite::Mode, Sprite::Mode::PERIODIC>()); break;
+			case Sprite::Mode::CLAMP: f(std::integral_constant<Sprite::Mode, Sprite::Mode::CLAMP>()); break;
+			}
+		}
+	}
+
+	// Nearest samples match Sample() exactly
+	void Sprite::Sample(const olc::vf2d* pUV, Pixel* pOut, size_t n) const
+	{
+		sample::ForMode(this, pOut, n, [&](auto m) { sample::Points<decltype(m)::value, false>(this, pUV, pOut, n); });
+	}
+
+	// Bilinear samples read the same texels as SampleBL(), but with 8 bit
+	// weights each channel can come out a step or two lower, and alpha is
+	// filtered too where SampleBL() returns opaque pixels
+	void Sprite::SampleBL(const olc::vf2d* pUV, Pixel* pOut, size_t n) const
+	{
+		sample::ForMode(this, pOut, n, [&](auto m) { sample::Points<decltype(m)::value, true>(this, pUV, pOut, n); });
+	}
+
+	// Sample(uv + duv * i) for i in [0, n). The start and step are rounded to
+	// 1/65536 of a texel, so along the row positions drift by up to n/131072
+	// of a texel, and a sample that close to a texel edge can pick its
+	// neighbour instead
+	void Sprite::SampleSpan(const olc::vf2d& uv, const olc::vf2d& duv, Pixel* pOut, size_t n) const
+	{
+		sample::ForMode(this, pOut, n, [&](auto m) { sample::Span<decltype(m)::value, false>(this, uv, duv, pOut, n); });
+	}
+
+	// SampleBL(uv + duv * i) for i in [0, n), as SampleSpan() and SampleBL()
+	void Sprite::SampleSpanBL(const olc::vf2d& uv, const olc::vf2d& duv, Pixel* pOut, size_t n) const
+	{
+		sample::ForMode(this, pOut, n, [&](auto m) { sample::Span<decltype(m)::value, true>(this, uv, duv, pOut, n); });
+	}
+
 	Pixel* Sprite::GetData()
 	{ return pColData.data(); }
 
@@ -2066,6 +2468,21 @@ namespace olc
 	//=============================================================
 	// Resource Packs - Allows you to store files in one large 
 	// scrambled file - Thanks MaGetzUb for debugging a null char in std::stringstream bug
+	//
+	// Version 1: uint32 index size, the scrambled index {uint32 count, then per
+	// file uint32 path size, path, uint32 size, uint32 offset}, then the files.
+	//
+	// Version 2, little endian:
+	//   0  "olcPACK2"
+	//   8  uint32 file count
+	//   12 uint32 index size
+	//   16 uint64 index offset
+	//   24 uint32 CRC32 of the index as stored
+	//   28 the files, each starting 16 byte aligned
+	//   then the scrambled index: one 32 byte entry per file {uint64 offset,
+	//   uint32 stored size, uint32 size, uint32 CRC32, uint32 FNV-1a hash of
+	//   the path, uint32 path offset, uint16 path size, uint8 compression,
+	//   uint8 0}, and the paths. The hash table is built when loading.
 	ResourceBuffer::ResourceBuffer(std::ifstream& ifs, uint32_t offset, uint32_t size)
 	{
 		vMemory.resize(size);
@@ -2073,8 +2490,78 @@ namespace olc
 		setg(vMemory.data(), vMemory.data(), vMemory.data() + size);
 	}
 
+	ResourceBuffer::ResourceBuffer(std::vector<char> vData) : vMemory(std::move(vData))
+	{
+		setg(vMemory.data(), vMemory.data(), vMemory.data() + vMemory.size());
+	}
+
+	bool ResourcePack::MappedFile::Open(const std::string& sFile)
+	{
+		Close();
+#if defined(_WIN32)
+		hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (hFile == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER nFileSize;
+		if (GetFileSizeEx(hFile, &nFileSize) && nFileSize.QuadPart > 0)
+		{
+			hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (hMapping != nullptr)
+				pData = (const uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+			if (pData != nullptr)
+			{
+				nSize = size_t(nFileSize.QuadPart);
+				bMapped = true;
+				return true;
+			}
+		}
+		Close();
+#elif !defined(__EMSCRIPTEN__)
+		int fd = ::open(sFile.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat st;
+		void* p = MAP_FAILED;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0)
+			p = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (p != MAP_FAILED)
+		{
+			pData = (const uint8_t*)p;
+			nSize = size_t(st.st_size);
+			bMapped = true;
+			return true;
+		}
+#endif
+		// Fall back to reading the whole file
+		std::ifstream ifs(sFile, std::ifstream::binary | std::ifstream::ate);
+		if (!ifs.is_open()) return false;
+		vFallback.resize(size_t(ifs.tellg()));
+		ifs.seekg(0);
+		if (!ifs.read((char*)vFallback.data(), vFallback.size())) { Close(); return false; }
+		pData = vFallback.data();
+		nSize = vFallback.size();
+		return true;
+	}
+
+	void ResourcePack::MappedFile::Close()
+	{
+#if defined(_WIN32)
+		if (bMapped) UnmapViewOfFile(pData);
+		if (hMapping != nullptr) CloseHandle(hMapping);
+		if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+		hMapping = nullptr;
+		hFile = INVALID_HANDLE_VALUE;
+#elif !defined(__EMSCRIPTEN__)
+		if (bMapped) ::munmap((void*)pData, nSize);
+#endif
+		bMapped = false;
+		vFallback.clear();
+		vFallback.shrink_to_fit();
+		pData = nullptr;
+		nSize = 0;
+	}
+
 	ResourcePack::ResourcePack() { }
-	ResourcePack::~ResourcePack() { baseFile.close(); }
+	ResourcePack::~ResourcePack() { }
 
 	bool ResourcePack::AddFile(const std::string& sFile)
 	{
@@ -2093,51 +2580,123 @@ namespace olc
 
 	bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey)
 	{
-		// Open the resource file
-		baseFile.open(sFile, std::ifstream::binary);
-		if (!baseFile.is_open()) return false;
+		vecEntries.clear();
+		vecSlots.clear();
+		sNames.clear();
+		bChecksums = false;
+
+		// The pack stays mapped, files are read from it when requested
+		if (!mapped.Open(sFile)) return false;
+
+		bool bVersion2 = mapped.nSize >= 8 && memcmp(mapped.pData, "olcPACK2", 8) == 0;
+		if (bVersion2 ? loadv2(sKey) : loadv1(sKey))
+		{
+			vecSlots = buildslots(vecEntries);
+			return true;
+		}
+
+		vecEntries.clear();
+		sNames.clear();
+		bChecksums = false;
+		mapped.Close();
+		return false;
+	}
 
+	bool ResourcePack::loadv1(const std::string& sKey)
+	{
 		// 1) Read Scrambled index
 		uint32_t nIndexSize = 0;
-		baseFile.read((char*)&nIndexSize, sizeof(uint32_t));
-
-		std::vector<char> buffer(nIndexSize);
-		for (uint32_t j = 0; j < nIndexSize; j++)
-			buffer[j] = baseFile.get();
+		if (mapped.nSize < sizeof(uint32_t)) return false;
+		memcpy(&nIndexSize, mapped.pData, sizeof(uint32_t));
+		if (nIndexSize > mapped.nSize - sizeof(uint32_t)) return false;
 
-		std::vector<char> decoded = scramble(buffer, sKey);
+		const char* pIndex = (const char*)mapped.pData + sizeof(uint32_t);
+		std::vector<char> decoded = scramble(std::vector<char>(pIndex, pIndex + nIndexSize), sKey);
 		size_t pos = 0;
-		auto read = [&decoded, &pos](char* dst, size_t size) {
-			memcpy((void*)dst, (const void*)(decoded.data() + pos), size);
-			pos += size;
+		auto read = [&decoded, &pos](uint32_t& n) {
+			if (decoded.size() - pos < sizeof(uint32_t)) return false;
+			memcpy(&n, decoded.data() + pos, sizeof(uint32_t));
+			pos += sizeof(uint32_t);
+			return true;
 		};
 
-		auto get = [&read]() -> int { char c; read(&c, 1); return c; };
-
-		// 2) Read Map
+		// 2) Read Map, where every entry is at least 12 bytes
 		uint32_t nMapEntries = 0;
-		read((char*)&nMapEntries, sizeof(uint32_t));
+		if (!read(nMapEntries) || nMapEntries > decoded.size() / 12) return false;
+		vecEntries.reserve(nMapEntries);
 		for (uint32_t i = 0; i < nMapEntries; i++)
 		{
 			uint32_t nFilePathSize = 0;
-			read((char*)&nFilePathSize, sizeof(uint32_t));
-
-			std::string sFileName(nFilePathSize, ' ');
-			for (uint32_t j = 0; j < nFilePathSize; j++)
-				sFileName[j] = get();
-
-			sResourceFile e;
-			read((char*)&e.nSize, sizeof(uint32_t));
-			read((char*)&e.nOffset, sizeof(uint32_t));
-			mapFiles[sFileName] = e;
+			if (!read(nFilePathSize) || nFilePathSize > decoded.size() - pos) return false;
+
+			sEntry e = {};
+			e.nName = uint32_t(sNames.size());
+			e.nNameSize = nFilePathSize;
+			e.nHash = hash(decoded.data() + pos, nFilePathSize);
+			sNames.append(decoded.data() + pos, nFilePathSize);
+			pos += nFilePathSize;
+
+			uint32_t nOffset = 0;
+			if (!read(e.nSize) || !read(nOffset)) return false;
+			if (uint64_t(nOffset) + e.nSize > mapped.nSize) return false;
+			e.nOffset = nOffset;
+			e.nStoredSize = e.nSize;
+			vecEntries.push_back(e);
 		}
+		return true;
+	}
 
-		// Don't close base file! we will provide a stream
-		// pointer when the file is requested
+	bool ResourcePack::loadv2(const std::string& sKey)
+	{
+		if (mapped.nSize < 28) return false;
+		uint32_t nEntries = 0, nIndexSize = 0, nIndexCrc = 0;
+		uint64_t nIndexOffset = 0;
+		memcpy(&nEntries, mapped.pData + 8, sizeof(uint32_t));
+		memcpy(&nIndexSize, mapped.pData + 12, sizeof(uint32_t));
+		memcpy(&nIndexOffset, mapped.pData + 16, sizeof(uint64_t));
+		memcpy(&nIndexCrc, mapped.pData + 24, sizeof(uint32_t));
+
+		// Check the index is whole before trusting anything in it
+		if (nIndexOffset < 28 || nIndexOffset > mapped.nSize || nIndexSize > mapped.nSize - nIndexOffset) return false;
+		uint64_t nTable = uint64_t(nEntries) * 32;
+		if (nTable > nIndexSize) return false;
+		const uint8_t* pIndex = mapped.pData + nIndexOffset;
+		if (crc32(pIndex, nIndexSize) != nIndexCrc) return false;
+
+		std::vector<char> decoded = scramble(std::vector<char>(pIndex, pIndex + nIndexSize), sKey);
+		const char* pEntry = decoded.data();
+		sNames.assign(decoded.data() + nTable, decoded.size() - size_t(nTable));
+
+		vecEntries.resize(nEntries);
+		for (auto& e : vecEntries)
+		{
+			uint16_t nNameSize = 0;
+			memcpy(&e.nOffset, pEntry, sizeof(uint64_t));
+			memcpy(&e.nStoredSize, pEntry + 8, sizeof(uint32_t));
+			memcpy(&e.nSize, pEntry + 12, sizeof(uint32_t));
+			memcpy(&e.nCrc, pEntry + 16, sizeof(uint32_t));
+			memcpy(&e.nHash, pEntry + 20, sizeof(uint32_t));
+			memcpy(&e.nName, pEntry + 24, sizeof(uint32_t));
+			memcpy(&nNameSize, pEntry + 28, sizeof(uint16_t));
+			e.nNameSize = nNameSize;
+			e.nCompression = uint8_t(pEntry[30]);
+			pEntry += 32;
+
+			if (e.nOffset < 28 || e.nOffset > nIndexOffset || e.nStoredSize > nIndexOffset - e.nOffset) return false;
+			if (e.nCompression > 1 || (e.nCompression == 0 && e.nStoredSize != e.nSize)) return false;
+			if (e.nName > sNames.size() || e.nNameSize > sNames.size() - e.nName) return false;
+			if (e.nHash != hash(sNames.data() + e.nName, e.nNameSize)) return false;
+		}
+		bChecksums = true;
 		return true;
 	}
 
-	bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey)
+	bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey, uint32_t nVersion, bool bCompress)
+	{
+		return nVersion < 2 ? savev1(sFile, sKey) : savev2(sFile, sKey, bCompress);
+	}
+
+	bool ResourcePack::savev1(const std::string& sFile, const std::string& sKey)
 	{
 		// Create/Overwrite the resource file
 		std::ofstream ofs(sFile, std::ofstream::binary);
@@ -2163,19 +2722,20 @@ namespace olc
 		// 2) Write the individual Data
 		std::streampos offset = ofs.tellp();
 		nIndexSize = (uint32_t)offset;
+		std::vector<char> vBuffer;
 		for (auto& e : mapFiles)
 		{
 			// Store beginning of file offset within resource pack file
 			e.second.nOffset = (uint32_t)offset;
 
 			// Load the file to be added
-			std::vector<uint8_t> vBuffer(e.second.nSize);
+			vBuffer.resize(e.second.nSize);
 			std::ifstream i(e.first, std::ifstream::binary);
-			i.read((char*)vBuffer.data(), e.second.nSize);
+			if (!i.read(vBuffer.data(), e.second.nSize)) return false;
 			i.close();
 
 			// Write the loaded file into resource pack file
-			ofs.write((char*)vBuffer.data(), e.second.nSize);
+			ofs.write(vBuffer.data(), e.second.nSize);
 			offset += e.second.nSize;
 		}
 
@@ -2208,21 +2768,314 @@ namespace olc
 		ofs.write((char*)&nIndexStringLen, sizeof(uint32_t));
 		ofs.write(sIndexString.data(), nIndexStringLen);
 		ofs.close();
-		return true;
+		return ofs.good();
+	}
+
+	bool ResourcePack::savev2(const std::string& sFile, const std::string& sKey, bool bCompress)
+	{
+		std::ofstream ofs(sFile, std::ofstream::binary);
+		if (!ofs.is_open()) return false;
+
+		// 1) Header, rewritten once the index is placed
+		char header[28] = {};
+		ofs.write(header, sizeof(header));
+		uint64_t nOffset = sizeof(header);
+
+		// 2) Files, one read and compression buffer for all of them
+		std::vector<sEntry> entries;
+		std::string names;
+		std::vector<char> vBuffer, vPacked;
+		for (auto& f : mapFiles)
+		{
+			if (f.first.size() > UINT16_MAX) return false;
+			vBuffer.resize(f.second.nSize);
+			std::ifstream ifs(f.first, std::ifstream::binary);
+			if (!ifs.read(vBuffer.data(), vBuffer.size())) return false;
+
+			sEntry e = {};
+			e.nSize = f.second.nSize;
+			e.nCrc = crc32((const uint8_t*)vBuffer.data(), vBuffer.size());
+			e.nHash = hash(f.first.data(), f.first.size());
+			e.nName = uint32_t(names.size());
+			e.nNameSize = uint32_t(f.first.size());
+			names += f.first;
+
+			const char* pStored = vBuffer.data();
+			e.nStoredSize = e.nSize;
+			if (bCompress && e.nSize > 0)
+			{
+				compress(vBuffer, vPacked);
+				if (vPacked.size() <= e.nSize - e.nSize / 8)
+				{
+					pStored = vPacked.data();
+					e.nStoredSize = uint32_t(vPacked.size());
+					e.nCompression = 1;
+				}
+			}
+
+			// Aligned so spans of the file are too, the mapping itself is page aligned
+			static const char padding[16] = {};
+			size_t nPad = size_t((16 - nOffset % 16) % 16);
+			ofs.write(padding, nPad);
+			e.nOffset = nOffset + nPad;
+			ofs.write(pStored, e.nStoredSize);
+			nOffset = e.nOffset + e.nStoredSize;
+			entries.push_back(e);
+		}
+
+		// 3) Scramble Index
+		std::vector<char> stream(entries.size() * 32 + names.size(), 0);
+		char* pEntry = stream.data();
+		for (auto& e : entries)
+		{
+			uint16_t nNameSize = uint16_t(e.nNameSize);
+			memcpy(pEntry, &e.nOffset, sizeof(uint64_t));
+			memcpy(pEntry + 8, &e.nStoredSize, sizeof(uint32_t));
+			memcpy(pEntry + 12, &e.nSize, sizeof(uint32_t));
+			memcpy(pEntry + 16, &e.nCrc, sizeof(uint32_t));
+			memcpy(pEntry + 20, &e.nHash, sizeof(uint32_t));
+			memcpy(pEntry + 24, &e.nName, sizeof(uint32_t));
+			memcpy(pEntry + 28, &nNameSize, sizeof(uint16_t));
+			pEntry[30] = char(e.nCompression);
+			pEntry += 32;
+		}
+		memcpy(pEntry, names.data(), names.size());
+		std::vector<char> index = scramble(stream, sKey);
+		ofs.write(index.data(), index.size());
+
+		// 4) Header
+		uint32_t nEntries = uint32_t(entries.size());
+		uint32_t nIndexSize = uint32_t(index.size());
+		uint32_t nIndexCrc = crc32((const uint8_t*)index.data(), index.size());
+		memcpy(header, "olcPACK2", 8);
+		memcpy(header + 8, &nEntries, sizeof(uint32_t));
+		memcpy(header + 12, &nIndexSize, sizeof(uint32_t));
+		memcpy(header + 16, &nOffset, sizeof(uint64_t));
+		memcpy(header + 24, &nIndexCrc, sizeof(uint32_t));
+		ofs.seekp(0, std::ios::beg);
+		ofs.write(header, sizeof(header));
+		ofs.close();
+		return ofs.good();
 	}
 
 	ResourceBuffer ResourcePack::GetFileBuffer(const std::string& sFile)
-	{ return ResourceBuffer(baseFile, mapFiles[sFile].nOffset, mapFiles[sFile].nSize); }
+	{
+		std::vector<char> vData;
+		const sEntry* e = find(sFile);
+		if (e == nullptr || !read(*e, vData)) vData.clear();
+		return ResourceBuffer(std::move(vData));
+	}
+
+	ResourceSpan ResourcePack::GetFileSpan(const std::string& sFile) const
+	{
+		const sEntry* e = find(sFile);
+		if (e == nullptr || e->nCompression != 0) return {};
+		return { mapped.pData + e->nOffset, e->nSize };
+	}
+
+	bool ResourcePack::Verify(const std::string& sFile) const
+	{
+		if (!mapped.pData) return false;
+		if (!sFile.empty())
+		{
+			const sEntry* e = find(sFile);
+			std::vector<char> vData;
+			return e != nullptr && (e->nCompression == 0 ? !bChecksums || crc32(mapped.pData + e->nOffset, e->nSize) == e->nCrc : read(*e, vData));
+		}
+
+		std::vector<char> vData;
+		for (auto& e : vecEntries)
+		{
+			bool bGood = e.nCompression == 0 ? !bChecksums || crc32(mapped.pData + e.nOffset, e.nSize) == e.nCrc : read(e, vData);
+			if (!bGood) return false;
+		}
+		return true;
+	}
 
 	bool ResourcePack::Loaded()
-	{ return baseFile.is_open(); }
+	{ return mapped.pData != nullptr; }
+
+	bool ResourcePack::read(const sEntry& e, std::vector<char>& vOut) const
+	{
+		vOut.resize(e.nSize);
+		const uint8_t* pStored = mapped.pData + e.nOffset;
+		if (e.nCompression == 0)
+			memcpy(vOut.data(), pStored, e.nSize);
+		else if (!decompress(pStored, e.nStoredSize, (uint8_t*)vOut.data(), vOut.size()))
+			return false;
+		return !bChecksums || crc32((const uint8_t*)vOut.data(), vOut.size()) == e.nCrc;
+	}
+
+	std::vector<uint32_t> ResourcePack::buildslots(const std::vector<sEntry>& entries)
+	{
+		uint32_t nSlots = 2;
+		while (nSlots < entries.size() * 2) nSlots <<= 1;
+		std::vector<uint32_t> slots(nSlots, 0);
+		for (uint32_t i = 0; i < entries.size(); i++)
+		{
+			uint32_t s = entries[i].nHash & (nSlots - 1);
+			while (slots[s] != 0) s = (s + 1) & (nSlots - 1);
+			slots[s] = i + 1;
+		}
+		return slots;
+	}
+
+	const ResourcePack::sEntry* ResourcePack::find(const std::string& sFile) const
+	{
+		if (vecSlots.empty()) return nullptr;
+		std::string sPosix;
+		if (sFile.find('\\') != std::string::npos) sPosix = makeposix(sFile);
+		const std::string& sPath = sPosix.empty() ? sFile : sPosix;
+
+		uint32_t nHash = hash(sPath.data(), sPath.size());
+		uint32_t nMask = uint32_t(vecSlots.size()) - 1;
+		for (uint32_t s = nHash & nMask; vecSlots[s] != 0; s = (s + 1) & nMask)
+		{
+			const sEntry& e = vecEntries[vecSlots[s] - 1];
+			if (e.nHash == nHash && e.nNameSize == sPath.size() && sNames.compare(e.nName, e.nNameSize, sPath) == 0)
+				return &e;
+		}
+		return nullptr;
+	}
+
+	uint32_t ResourcePack::hash(const char* data, size_t size)
+	{
+		// FNV-1a
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < size; i++) h = (h ^ uint8_t(data[i])) * 16777619u;
+		return h;
+	}
+
+	uint32_t ResourcePack::crc32(const uint8_t* data, size_t size)
+	{
+		// Slicing by 8: table k advances a byte's CRC through k more zero bytes,
+		// so eight bytes are folded in per step
+		static const auto table = []()
+		{
+			std::array<std::array<uint32_t, 256>, 8> t{};
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[0][n] = c;
+			}
+			for (uint32_t n = 0; n < 256; n++)
+				for (int k = 1; k < 8; k++) t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xFF];
+			return t;
+		}();
+
+		uint32_t crc = ~0u;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			uint32_t lo, hi;
+			memcpy(&lo, data + i, 4);
+			memcpy(&hi, data + i + 4, 4);
+			lo ^= crc;
+			crc = table[7][lo & 0xFF] ^ table[6][(lo >> 8) & 0xFF] ^ table[5][(lo >> 16) & 0xFF] ^ table[4][lo >> 24]
+				^ table[3][hi & 0xFF] ^ table[2][(hi >> 8) & 0xFF] ^ table[1][(hi >> 16) & 0xFF] ^ table[0][hi >> 24];
+		}
+		for (; i < size; i++) crc = table[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	// LZ4 block format: sequences of a token (literal count << 4 | match
+	// length - 4, 15 meaning more length bytes follow), the literals, and a
+	// 16 bit back offset to a match of at least 4 bytes. The last sequence is
+	// literals only and holds at least the final 5 bytes.
+	void ResourcePack::compress(const std::vector<char>& vIn, std::vector<char>& vOut)
+	{
+		vOut.clear();
+		vOut.reserve(vIn.size() + vIn.size() / 255 + 16);
+		const uint8_t* src = (const uint8_t*)vIn.data();
+		size_t n = vIn.size(), anchor = 0;
+
+		auto length = [&vOut](size_t v) {
+			for (; v >= 255; v -= 255) vOut.push_back(char(255));
+			vOut.push_back(char(v));
+		};
+		auto sequence = [&](size_t nLiterals, size_t nMatch, size_t nBack) {
+			size_t nMatchCode = nMatch > 0 ? nMatch - 4 : 0;
+			vOut.push_back(char((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15)));
+			if (nLiterals >= 15) length(nLiterals - 15);
+			vOut.insert(vOut.end(), vIn.begin() + anchor, vIn.begin() + anchor + nLiterals);
+			if (nMatch == 0) return;
+			vOut.push_back(char(nBack & 0xFF));
+			vOut.push_back(char(nBack >> 8));
+			if (nMatchCode >= 15) length(nMatchCode - 15);
+		};
+
+		// Greedy, remembering the last position of each hashed 4 byte sequence.
+		// Matches start at least 12 bytes and end at least 5 bytes from the end.
+		if (n > 12)
+		{
+			std::vector<uint32_t> table(4096, UINT32_MAX);
+			size_t i = 0;
+			while (i < n - 12)
+			{
+				uint32_t seq;
+				memcpy(&seq, src + i, 4);
+				uint32_t h = (seq * 2654435761u) >> 20;
+				size_t nCandidate = table[h];
+				table[h] = uint32_t(i);
+				if (nCandidate != UINT32_MAX && i - nCandidate <= 65535 && memcmp(src + nCandidate, src + i, 4) == 0)
+				{
+					size_t nMatch = 4;
+					while (i + nMatch < n - 5 && src[nCandidate + nMatch] == src[i + nMatch]) nMatch++;
+					sequence(i - anchor, nMatch, i - nCandidate);
+					i += nMatch;
+					anchor = i;
+				}
+				else
+					i++;
+			}
+		}
+		sequence(n - anchor, 0, 0);
+	}
+
+	bool ResourcePack::decompress(const uint8_t* src, size_t nSrc, uint8_t* dst, size_t nDst)
+	{
+		size_t i = 0, o = 0;
+		auto length = [&](size_t& v) {
+			uint8_t b;
+			do { if (i >= nSrc) return false; b = src[i++]; v += b; } while (b == 255);
+			return true;
+		};
+
+		while (i < nSrc)
+		{
+			uint8_t token = src[i++];
+			size_t nLiterals = token >> 4;
+			if (nLiterals == 15 && !length(nLiterals)) return false;
+			if (nLiterals > nSrc - i || nLiterals > nDst - o) return false;
+			memcpy(dst + o, src + i, nLiterals);
+			i += nLiterals;
+			o += nLiterals;
+			if (i == nSrc) break;
+
+			if (nSrc - i < 2) return false;
+			size_t nBack = size_t(src[i]) | size_t(src[i + 1]) << 8;
+			i += 2;
+			size_t nMatch = token & 15;
+			if (nMatch == 15 && !length(nMatch)) return false;
+			nMatch += 4;
+			if (nBack == 0 || nBack > o || nMatch > nDst - o) return false;
+
+			// Matches may overlap what they copy, repeating it
+			if (nBack >= nMatch)
+				memcpy(dst + o, dst + o - nBack, nMatch);
+			else
+				for (size_t k = 0; k < nMatch; k++) dst[o + k] = dst[o + k - nBack];
+			o += nMatch;
+		}
+		return o == nDst;
+	}
 
 	std::vector<char> ResourcePack::scramble(const std::vector<char>& data, const std::string& key)
 	{
 		if (key.empty()) return data;
-		std::vector<char> o;
-		size_t c = 0;
-		for (auto s : data)	o.push_back(s ^ key[(c++) % key.size()]);
+		std::vector<char> o(data.size());
+		for (size_t c = 0; c < data.size(); c++) o[c] = data[c] ^ key[c % key.size()];
 		return o;
 	};
 
@@ -2247,7 +3100,9 @@ namespace olc
 	}
 
 	PixelGameEngine::~PixelGameEngine()
-	{}
+	{
+		olc_StopRasterWorkers();
+	}
 
 
 	olc::rcode PixelGameEngine::Construct(int32_t screen_w, int32_t screen_h, int32_t pixel_w, int32_t pixel_h, bool full_screen, bool vsync, bool cohesion, bool realwindow)
@@ -2325,6 +3180,7 @@ namespace olc
 			if(!vLayers.empty())
 				pDrawTarget = vLayers[0].pDrawTarget.Sprite();
 		}
+		olc_UpdateDirtyLayer();
 	}
 
 	void PixelGameEngine::SetDrawTarget(uint8_t layer, bool bDirty)
@@ -2334,6 +3190,78 @@ namespace olc
 			pDrawTarget = vLayers[layer].pDrawTarget.Sprite();
 			vLayers[layer].bUpdate = bDirty;
 			nTargetLayer = layer;
+			nDirtyLayer = layer;
+		}
+	}
+
+	void PixelGameEngine::MarkLayerDirty(uint8_t layer, const olc::vi2d& pos, const olc::vi2d& size)
+	{
+		if (layer >= vLayers.size()) return;
+		const olc::Sprite* spr = vLayers[layer].pDrawTarget.Sprite();
+		vLayers[layer].dirty.Add({ std::max(pos.x, 0), std::max(pos.y, 0) }, { std::min(pos.x + size.x, spr->width), std::min(pos.y + size.y, spr->height) });
+	}
+
+	void PixelGameEngine::olc_UpdateDirtyLayer()
+	{
+		nDirtyLayer = -1;
+		for (size_t i = 0; i < vLayers.size(); i++)
+			if (vLayers[i].pDrawTarget.Sprite() == pDrawTarget) nDirtyLayer = int32_t(i);
+	}
+
+	void PixelGameEngine::olc_MarkDirty(int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+	{
+		if (nDirtyLayer < 0) return;
+		vLayers[nDirtyLayer].dirty.Add({ std::max(x1, 0), std::max(y1, 0) }, { std::min(x2, pDrawTarget->width), std::min(y2, pDrawTarget->height) });
+	}
+
+	void DirtyRegion::Add(const olc::vi2d& tl, const olc::vi2d& br)
+	{
+		if (tl.x >= br.x || tl.y >= br.y) return;
+
+		// Overlapping or edge to edge
+		auto Touches = [](const std::pair<olc::vi2d, olc::vi2d>& a, const std::pair<olc::vi2d, olc::vi2d>& b)
+		{ return a.first.x <= b.second.x && b.first.x <= a.second.x && a.first.y <= b.second.y && b.first.y <= a.second.y; };
+		auto Union = [](const std::pair<olc::vi2d, olc::vi2d>& a, const std::pair<olc::vi2d, olc::vi2d>& b)
+		{
+			return std::pair<olc::vi2d, olc::vi2d>({ std::min(a.first.x, b.first.x), std::min(a.first.y, b.first.y) },
+				{ std::max(a.second.x, b.second.x), std::max(a.second.y, b.second.y) });
+		};
+		auto Area = [](const std::pair<olc::vi2d, olc::vi2d>& a)
+		{ return int64_t(a.second.x - a.first.x) * (a.second.y - a.first.y); };
+
+		// Pixels and spans mostly land in or beside the last rectangle grown
+		std::pair<olc::vi2d, olc::vi2d> r = { tl, br };
+		if (!vecRects.empty() && Touches(vecRects.back(), r))
+		{
+			vecRects.back() = Union(vecRects.back(), r);
+			return;
+		}
+
+		// Otherwise absorb everything it touches, and keep at most nMaxRects by
+		// merging the pair of rectangles that wastes the least area
+		for (size_t i = 0; i < vecRects.size();)
+		{
+			if (Touches(vecRects[i], r))
+			{
+				r = Union(vecRects[i], r);
+				vecRects.erase(vecRects.begin() + i);
+				i = 0;
+			}
+			else
+				i++;
+		}
+		vecRects.push_back(r);
+		if (vecRects.size() > nMaxRects)
+		{
+			size_t nBest = 0;
+			int64_t nBestWaste = INT64_MAX;
+			for (size_t i = 0; i + 1 < vecRects.size(); i++)
+			{
+				int64_t nWaste = Area(Union(vecRects[i], r)) - Area(vecRects[i]) - Area(r);
+				if (nWaste < nBestWaste) { nBestWaste = nWaste; nBest = i; }
+			}
+			vecRects[nBest] = Union(vecRects[nBest], r);
+			vecRects.pop_back();
 		}
 	}
 
@@ -2366,6 +3294,7 @@ namespace olc
 		LayerDesc ld;
 		ld.pDrawTarget.Create(vScreenSize.x, vScreenSize.y);
 		vLayers.push_back(std::move(ld));
+		olc_UpdateDirtyLayer();
 		return uint32_t(vLayers.size()) - 1;
 	}
 
@@ -2421,6 +3350,32 @@ namespace olc
 	float PixelGameEngine::GetElapsedTime() const
 	{ return fLastElapsed; }
 
+	void PixelGameEngine::SetFrameCap(float fFPS, float fSpin)
+	{
+		fFrameCap = fFPS > 0.0f ? 1.0f / fFPS : 0.0f;
+		fFrameSpin = std::max(fSpin, 0.0f);
+		tpNextFrame = std::chrono::steady_clock::now();
+	}
+
+	void PixelGameEngine::SetRedrawOnChange(bool bEnable, float fMaxIdle)
+	{
+		bRedrawOnChange = bEnable;
+		this->fMaxIdle = fMaxIdle;
+		bRedrawRequested = true;
+	}
+
+	void PixelGameEngine::RequestRedraw()
+	{ bRedrawRequested = true; }
+
+	const FrameStats& PixelGameEngine::GetFrameStats() const
+	{ return frameStats; }
+
+	void PixelGameEngine::SetFrameCallback(std::function<void(const olc::Sprite&)> f)
+	{ funcFrameCallback = std::move(f); }
+
+	const olc::Sprite* PixelGameEngine::GetFrameBuffer() const
+	{ return renderer->GetFrameBuffer(); }
+
 	const olc::vi2d& PixelGameEngine::GetWindowSize() const
 	{ return vWindowSize; }
 
@@ -2442,46 +3397,223 @@ namespace olc
 	bool PixelGameEngine::Draw(const olc::vi2d& pos, Pixel p)
 	{ return Draw(pos.x, pos.y, p); }
 
-	// This is it, the critical function that plots a pixel
-	bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
+	// Span blitters, which write a run of pixels along one row, specialised
+	// per pixel mode. Alpha blending is integer throughout, 8 bits of weight
+	// per channel, so the scalar and SSE2 paths give identical results.
+	namespace span
 	{
-		if (!pDrawTarget) return false;
-
-		if (nPixelMode == Pixel::NORMAL)
+		// x / 255, rounded, for x in [0, 65025]
+		inline uint32_t Div255(uint32_t x)
 		{
-			return pDrawTarget->SetPixel(x, y, p);
+			x += 128;
+			return (x + (x >> 8)) >> 8;
 		}
 
-		if (nPixelMode == Pixel::MASK)
+		// Pixel::ALPHA for a single pixel: s over d, weighted by s.a and the
+		// blend factor, with an opaque result
+		inline Pixel BlendPixel(Pixel s, Pixel d, uint32_t nBlend)
 		{
-			if (p.a == 255)
-				return pDrawTarget->SetPixel(x, y, p);
+			uint32_t a = Div255(s.a * nBlend), c = 255 - a;
+			return Pixel(uint8_t(Div255(s.r * a + d.r * c)), uint8_t(Div255(s.g * a + d.g * c)), uint8_t(Div255(s.b * a + d.b * c)));
 		}
 
-		if (nPixelMode == Pixel::ALPHA)
+#if defined(OLC_SIMD_SSE2)
+		// Div255 on eight 16-bit lanes of x + 128
+		inline __m128i Div255Biased(__m128i t)
 		{
-			Pixel d = pDrawTarget->GetPixel(x, y);
-			float a = (float)(p.a / 255.0f) * fBlendFactor;
-			float c = 1.0f - a;
-			float r = a * (float)p.r + c * (float)d.r;
-			float g = a * (float)p.g + c * (float)d.g;
-			float b = a * (float)p.b + c * (float)d.b;
-			return pDrawTarget->SetPixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b/*, (uint8_t)(p.a * fBlendFactor)*/));
+			return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
 		}
 
-		if (nPixelMode == Pixel::CUSTOM)
+		// Blends two pixels held as 16-bit channels: s * a + d * (255 - a)
+		inline __m128i Blend16(__m128i s, __m128i d, __m128i a)
 		{
-			return pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)));
+			__m128i t = _mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+			return Div255Biased(_mm_add_epi16(t, _mm_set1_epi16(128)));
 		}
+#endif
 
-		return false;
-	}
-
+		template<Pixel::Mode MODE> struct Blit;
 
-	void PixelGameEngine::DrawLine(const olc::vi2d& pos1, const olc::vi2d& pos2, Pixel p, uint32_t pattern)
-	{ DrawLine(pos1.x, pos1.y, pos2.x, pos2.y, p, pattern); }
+		template<> struct Blit<Pixel::NORMAL>
+		{
+			static void Fill(Pixel* d, int32_t n, Pixel p, uint32_t)
+			{
+				int32_t i = 0;
+#if defined(OLC_SIMD_SSE2)
+				__m128i v = _mm_set1_epi32(int32_t(p.n));
+				for (; i + 4 <= n; i += 4)
+					_mm_storeu_si128((__m128i*)(d + i), v);
+#endif
+				for (; i < n; i++) d[i] = p;
+			}
 
-	void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
+			static void Copy(Pixel* d, const Pixel* s, int32_t n, uint32_t)
+			{
+				std::memcpy(d, s, size_t(n) * sizeof(Pixel));
+			}
+		};
+
+		template<> struct Blit<Pixel::MASK>
+		{
+			static void Fill(Pixel* d, int32_t n, Pixel p, uint32_t nBlend)
+			{
+				if (p.a == 255) Blit<Pixel::NORMAL>::Fill(d, n, p, nBlend);
+			}
+
+			static void Copy(Pixel* d, const Pixel* s, int32_t n, uint32_t)
+			{
+				int32_t i = 0;
+#if defined(OLC_SIMD_SSE2)
+				const __m128i vAlpha = _mm_set1_epi32(int32_t(0xFF000000));
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128i vs = _mm_loadu_si128((const __m128i*)(s + i));
+					__m128i vd = _mm_loadu_si128((const __m128i*)(d + i));
+					__m128i m = _mm_cmpeq_epi32(_mm_and_si128(vs, vAlpha), vAlpha);
+					_mm_storeu_si128((__m128i*)(d + i), _mm_or_si128(_mm_and_si128(m, vs), _mm_andnot_si128(m, vd)));
+				}
+#endif
+				for (; i < n; i++) if (s[i].a == 255) d[i] = s[i];
+			}
+		};
+
+		template<> struct Blit<Pixel::ALPHA>
+		{
+			static void Fill(Pixel* d, int32_t n, Pixel p, uint32_t nBlend)
+			{
+				uint32_t a = Div255(p.a * nBlend), c = 255 - a;
+				int32_t i = 0;
+#if defined(OLC_SIMD_SSE2)
+				// The source half of each sum is the same for every pixel. Its
+				// alpha lane is 255 * 255 with a weight of 0 on the target, so
+				// alpha always comes out as 255, as in BlendPixel().
+				const __m128i vS = _mm_set_epi16(int16_t(65153), int16_t(p.b * a + 128), int16_t(p.g * a + 128), int16_t(p.r * a + 128),
+					int16_t(65153), int16_t(p.b * a + 128), int16_t(p.g * a + 128), int16_t(p.r * a + 128));
+				const __m128i vC = _mm_set_epi16(0, int16_t(c), int16_t(c), int16_t(c), 0, int16_t(c), int16_t(c), int16_t(c));
+				const __m128i vZero = _mm_setzero_si128();
+				for (; i + 8 <= n; i += 8)
+				{
+					__m128i v0 = _mm_loadu_si128((const __m128i*)(d + i));
+					__m128i v1 = _mm_loadu_si128((const __m128i*)(d + i + 4));
+					__m128i r0 = Div255Biased(_mm_add_epi16(vS, _mm_mullo_epi16(_mm_unpacklo_epi8(v0, vZero), vC)));
+					__m128i r1 = Div255Biased(_mm_add_epi16(vS, _mm_mullo_epi16(_mm_unpackhi_epi8(v0, vZero), vC)));
+					__m128i r2 = Div255Biased(_mm_add_epi16(vS, _mm_mullo_epi16(_mm_unpacklo_epi8(v1, vZero), vC)));
+					__m128i r3 = Div255Biased(_mm_add_epi16(vS, _mm_mullo_epi16(_mm_unpackhi_epi8(v1, vZero), vC)));
+					_mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(r0, r1));
+					_mm_storeu_si128((__m128i*)(d + i + 4), _mm_packus_epi16(r2, r3));
+				}
+#endif
+				for (; i < n; i++)
+					d[i] = Pixel(uint8_t(Div255(p.r * a + d[i].r * c)), uint8_t(Div255(p.g * a + d[i].g * c)), uint8_t(Div255(p.b * a + d[i].b * c)));
+			}
+
+			static void Copy(Pixel* d, const Pixel* s, int32_t n, uint32_t nBlend)
+			{
+				int32_t i = 0;
+#if defined(OLC_SIMD_SSE2)
+				const __m128i vZero = _mm_setzero_si128();
+				const __m128i vBlend = _mm_set1_epi16(int16_t(nBlend));
+				const __m128i vOpaque = _mm_set1_epi32(int32_t(0xFF000000));
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128i vs = _mm_loadu_si128((const __m128i*)(s + i));
+					__m128i vd = _mm_loadu_si128((const __m128i*)(d + i));
+					__m128i slo = _mm_unpacklo_epi8(vs, vZero), shi = _mm_unpackhi_epi8(vs, vZero);
+					// Each pixel's alpha copied to all four of its lanes, then
+					// scaled by the blend factor
+					__m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xFF), 0xFF);
+					__m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xFF), 0xFF);
+					alo = Div255Biased(_mm_add_epi16(_mm_mullo_epi16(alo, vBlend), _mm_set1_epi16(128)));
+					ahi = Div255Biased(_mm_add_epi16(_mm_mullo_epi16(ahi, vBlend), _mm_set1_epi16(128)));
+					__m128i rlo = Blend16(slo, _mm_unpacklo_epi8(vd, vZero), alo);
+					__m128i rhi = Blend16(shi, _mm_unpackhi_epi8(vd, vZero), ahi);
+					_mm_storeu_si128((__m128i*)(d + i), _mm_or_si128(_mm_packus_epi16(rlo, rhi), vOpaque));
+				}
+#endif
+				for (; i < n; i++) d[i] = BlendPixel(s[i], d[i], nBlend);
+			}
+		};
+
+		// Nearest-neighbour scaling along a row: each of n source pixels is
+		// written nScale times
+		inline void Expand(Pixel* d, const Pixel* s, int32_t n, uint32_t nScale)
+		{
+			int32_t i = 0;
+#if defined(OLC_SIMD_SSE2)
+			if (nScale == 2)
+				for (; i + 4 <= n; i += 4)
+				{
+					__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+					_mm_storeu_si128((__m128i*)(d + i * 2), _mm_unpacklo_epi32(v, v));
+					_mm_storeu_si128((__m128i*)(d + i * 2 + 4), _mm_unpackhi_epi32(v, v));
+				}
+			else if (nScale >= 4)
+				for (; i < n; i++)
+				{
+					__m128i v = _mm_set1_epi32(int32_t(s[i].n));
+					uint32_t k = 0;
+					for (; k + 4 <= nScale; k += 4)
+						_mm_storeu_si128((__m128i*)(d + i * nScale + k), v);
+					for (; k < nScale; k++) d[i * nScale + k] = s[i];
+				}
+#endif
+			for (; i < n; i++)
+				for (uint32_t k = 0; k < nScale; k++) d[i * nScale + k] = s[i];
+		}
+
+		inline SpanBlitter Blitter(Pixel::Mode m, uint32_t nBlend)
+		{
+			SpanBlitter blit;
+			blit.nBlend = nBlend;
+			switch (m)
+			{
+			case Pixel::NORMAL: blit.Fill = Blit<Pixel::NORMAL>::Fill; blit.Copy = Blit<Pixel::NORMAL>::Copy; break;
+			case Pixel::MASK:   blit.Fill = Blit<Pixel::MASK>::Fill;   blit.Copy = Blit<Pixel::MASK>::Copy;   break;
+			case Pixel::ALPHA:  blit.Fill = Blit<Pixel::ALPHA>::Fill;  blit.Copy = Blit<Pixel::ALPHA>::Copy;  break;
+			default: break;
+			}
+			return blit;
+		}
+
+		// Draw() for every mode but CUSTOM
+		inline bool Plot(Sprite* t, int32_t x, int32_t y, Pixel p, Pixel::Mode m, uint32_t nBlend)
+		{
+			if (x < 0 || x >= t->width || y < 0 || y >= t->height) return false;
+			Pixel& d = t->pColData[size_t(y) * t->width + x];
+			switch (m)
+			{
+			case Pixel::NORMAL: d = p; return true;
+			case Pixel::MASK: if (p.a != 255) return false; d = p; return true;
+			case Pixel::ALPHA: d = BlendPixel(p, d, nBlend); return true;
+			default: return false;
+			}
+		}
+	}
+
+	// This is it, the critical function that plots a pixel
+	bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
+	{
+		if (!pDrawTarget) return false;
+		if (!vecCommands.empty()) FlushCommands();
+
+		if (nPixelMode == Pixel::CUSTOM)
+		{
+			if (!pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)))) return false;
+			olc_MarkDirty(x, y, x + 1, y + 1);
+			return true;
+		}
+
+		if (!span::Plot(pDrawTarget, x, y, p, nPixelMode, nBlendFactor)) return false;
+		olc_MarkDirty(x, y, x + 1, y + 1);
+		return true;
+	}
+
+
+	void PixelGameEngine::DrawLine(const olc::vi2d& pos1, const olc::vi2d& pos2, Pixel p, uint32_t pattern)
+	{ DrawLine(pos1.x, pos1.y, pos2.x, pos2.y, p, pattern); }
+
+	template<typename PLOT>
+	void PixelGameEngine::olc_RasterLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern, PLOT&& plot)
 	{
 		int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
 		dx = x2 - x1; dy = y2 - y1;
@@ -2498,14 +3630,14 @@ namespace olc
 		if (dx == 0) // Line is vertical
 		{
 			if (y2 < y1) std::swap(y1, y2);
-			for (y = y1; y <= y2; y++) if (rol()) Draw(x1, y, p);
+			for (y = y1; y <= y2; y++) if (rol()) plot(x1, y, p);
 			return;
 		}
 
 		if (dy == 0) // Line is horizontal
 		{
 			if (x2 < x1) std::swap(x1, x2);
-			for (x = x1; x <= x2; x++) if (rol()) Draw(x, y1, p);
+			for (x = x1; x <= x2; x++) if (rol()) plot(x, y1, p);
 			return;
 		}
 
@@ -2523,7 +3655,7 @@ namespace olc
 				x = x2; y = y2; xe = x1;
 			}
 
-			if (rol()) Draw(x, y, p);
+			if (rol()) plot(x, y, p);
 
 			for (i = 0; x < xe; i++)
 			{
@@ -2535,7 +3667,7 @@ namespace olc
 					if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
 					px = px + 2 * (dy1 - dx1);
 				}
-				if (rol()) Draw(x, y, p);
+				if (rol()) plot(x, y, p);
 			}
 		}
 		else
@@ -2549,7 +3681,7 @@ namespace olc
 				x = x2; y = y2; ye = y1;
 			}
 
-			if (rol()) Draw(x, y, p);
+			if (rol()) plot(x, y, p);
 
 			for (i = 0; y < ye; i++)
 			{
@@ -2561,11 +3693,35 @@ namespace olc
 					if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
 					py = py + 2 * (dx1 - dy1);
 				}
-				if (rol()) Draw(x, y, p);
+				if (rol()) plot(x, y, p);
 			}
 		}
 	}
 
+	void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
+	{
+		if (olc_RecordCommand())
+		{
+			olc::vi2d p1(x1, y1), p2(x2, y2);
+			if (!ClipLineToScreen(p1, p2))
+				return;
+			DrawCommand cmd;
+			cmd.pTarget = pDrawTarget;
+			cmd.type = DrawCommand::Type::Line;
+			cmd.x1 = x1; cmd.y1 = y1; cmd.x2 = x2; cmd.y2 = y2;
+			cmd.p = p;
+			cmd.nParam = pattern;
+			// Clipped ends are rounded towards zero, so the drawn line can stray a pixel past them
+			cmd.nTop = std::min(p1.y, p2.y) - 1;
+			cmd.nBottom = std::max(p1.y, p2.y) + 1;
+			olc_MarkDirty(std::min(p1.x, p2.x) - 1, cmd.nTop, std::max(p1.x, p2.x) + 2, cmd.nBottom + 1);
+			vecCommands.push_back(std::move(cmd));
+			return;
+		}
+
+		olc_RasterLine(x1, y1, x2, y2, p, pattern, [&](int32_t x, int32_t y, Pixel c) { Draw(x, y, c); });
+	}
+
 	void PixelGameEngine::DrawCircle(const olc::vi2d& pos, int32_t radius, Pixel p, uint8_t mask)
 	{ DrawCircle(pos.x, pos.y, radius, p, mask); }
 
@@ -2619,10 +3775,10 @@ namespace olc
 			int y0 = radius;
 			int d = 3 - 2 * radius;
 
+			SpanBlitter blit = GetSpanBlitter();
 			auto drawline = [&](int sx, int ex, int y)
 			{
-				for (int x = sx; x <= ex; x++)
-					Draw(x, y, p);
+				FillSpan(blit, sx, ex, y, p);
 			};
 
 			while (y0 >= x0)
@@ -2660,9 +3816,25 @@ namespace olc
 
 	void PixelGameEngine::Clear(Pixel p)
 	{
+		olc_MarkDirty(0, 0, GetDrawTargetWidth(), GetDrawTargetHeight());
+
+		// Clear ignores the pixel mode, so it can be recorded in any of them
+		if (olc_RecordCommand(nullptr, false))
+		{
+			DrawCommand cmd;
+			cmd.pTarget = pDrawTarget;
+			cmd.type = DrawCommand::Type::FillRect;
+			cmd.nMode = Pixel::NORMAL;
+			cmd.p = p;
+			cmd.x2 = pDrawTarget->width; cmd.y2 = pDrawTarget->height;
+			cmd.nTop = 0; cmd.nBottom = pDrawTarget->height - 1;
+			vecCommands.push_back(std::move(cmd));
+			return;
+		}
+
 		int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
 		Pixel* m = GetDrawTarget()->GetData();
-		for (int i = 0; i < pixels; i++) m[i] = p;
+		span::Blit<Pixel::NORMAL>::Fill(m, pixels, p, 255);
 	}
 
 	void PixelGameEngine::ClearBuffer(Pixel p, bool bDepth)
@@ -2710,6 +3882,20 @@ namespace olc
 	}
 
 
+	void PixelGameEngine::FillSpan(const SpanBlitter& blit, int32_t x1, int32_t x2, int32_t y, Pixel p)
+	{
+		if (!pDrawTarget || y < 0 || y >= pDrawTarget->height) return;
+		if (!vecCommands.empty()) FlushCommands();
+		x1 = std::max(x1, 0);
+		x2 = std::min(x2, pDrawTarget->width - 1);
+		if (x1 > x2) return;
+		olc_MarkDirty(x1, y, x2 + 1, y + 1);
+		if (blit.Fill)
+			blit.Fill(pDrawTarget->GetData() + size_t(y) * pDrawTarget->width + x1, x2 - x1 + 1, p, blit.nBlend);
+		else
+			for (int32_t x = x1; x <= x2; x++) Draw(x, y, p);
+	}
+
 	void PixelGameEngine::FillRect(const olc::vi2d& pos, const olc::vi2d& size, Pixel p)
 	{ FillRect(pos.x, pos.y, size.x, size.y, p); }
 
@@ -2728,9 +3914,36 @@ namespace olc
 		if (y2 < 0) y2 = 0;
 		if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
 
-		for (int i = x; i < x2; i++)
+		if (x >= x2 || y >= y2) return;
+		olc_MarkDirty(x, y, x2, y2);
+
+		if (olc_RecordCommand())
+		{
+			DrawCommand cmd;
+			cmd.pTarget = pDrawTarget;
+			cmd.type = DrawCommand::Type::FillRect;
+			cmd.nMode = nPixelMode; cmd.nBlend = nBlendFactor;
+			cmd.p = p;
+			cmd.x1 = x; cmd.y1 = y; cmd.x2 = x2; cmd.y2 = y2;
+			cmd.nTop = y; cmd.nBottom = y2 - 1;
+			vecCommands.push_back(std::move(cmd));
+			return;
+		}
+
+		// The rectangle is clipped, so rows can be written straight into the
+		// target a span at a time. Only CUSTOM still goes pixel by pixel.
+		SpanBlitter blit = GetSpanBlitter();
+		if (!blit.Fill)
+		{
 			for (int j = y; j < y2; j++)
-				Draw(i, j, p);
+				for (int i = x; i < x2; i++)
+					Draw(i, j, p);
+			return;
+		}
+
+		Pixel* pRow = pDrawTarget->GetData() + size_t(y) * pDrawTarget->width + x;
+		for (int j = y; j < y2; j++, pRow += pDrawTarget->width)
+			blit.Fill(pRow, x2 - x, p, blit.nBlend);
 	}
 
 	void PixelGameEngine::DrawTriangle(const olc::vi2d& pos1, const olc::vi2d& pos2, const olc::vi2d& pos3, Pixel p)
@@ -2749,7 +3962,8 @@ namespace olc
 	// https://www.avrfreaks.net/sites/default/files/triangles.c
 	void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
 	{
-		auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, p); };
+		SpanBlitter blit = GetSpanBlitter();
+		auto drawline = [&](int sx, int ex, int ny) { FillSpan(blit, sx, ex, ny, p); };
 
 		int t1x, t2x, y, minx, maxx, t1xp, t2xp;
 		bool changed1 = false;
@@ -3052,33 +4266,7 @@ namespace olc
 		if (sprite == nullptr)
 			return;
 
-		int32_t fxs = 0, fxm = 1, fx = 0;
-		int32_t fys = 0, fym = 1, fy = 0;
-		if (flip & olc::Sprite::Flip::HORIZ) { fxs = sprite->width - 1; fxm = -1; }
-		if (flip & olc::Sprite::Flip::VERT) { fys = sprite->height - 1; fym = -1; }
-
-		if (scale > 1)
-		{
-			fx = fxs;
-			for (int32_t i = 0; i < sprite->width; i++, fx += fxm)
-			{
-				fy = fys;
-				for (int32_t j = 0; j < sprite->height; j++, fy += fym)
-					for (uint32_t is = 0; is < scale; is++)
-						for (uint32_t js = 0; js < scale; js++)
-							Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx, fy));
-			}
-		}
-		else
-		{
-			fx = fxs;
-			for (int32_t i = 0; i < sprite->width; i++, fx += fxm)
-			{
-				fy = fys;
-				for (int32_t j = 0; j < sprite->height; j++, fy += fym)
-					Draw(x + i, y + j, sprite->GetPixel(fx, fy));
-			}
-		}
+		DrawPartialSprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale, flip);
 	}
 
 	void PixelGameEngine::DrawPartialSprite(const olc::vi2d& pos, Sprite* sprite, const olc::vi2d& sourcepos, const olc::vi2d& size, uint32_t scale, uint8_t flip)
@@ -3089,6 +4277,89 @@ namespace olc
 		if (sprite == nullptr)
 			return;
 
+		if (olc_RecordCommand(sprite))
+		{
+			DrawCommand cmd;
+			cmd.pTarget = pDrawTarget;
+			cmd.type = DrawCommand::Type::Sprite;
+			cmd.nMode = nPixelMode; cmd.nBlend = nBlendFactor;
+			cmd.x1 = x; cmd.y1 = y;
+			cmd.pSprite = sprite;
+			cmd.ox = ox; cmd.oy = oy; cmd.w = w; cmd.h = h;
+			cmd.nParam = scale; cmd.nFlip = flip;
+			cmd.nTop = y; cmd.nBottom = y + h * int32_t(std::max(scale, 1u)) - 1;
+			olc_MarkDirty(x, y, x + w * int32_t(std::max(scale, 1u)), cmd.nBottom + 1);
+			vecCommands.push_back(std::move(cmd));
+			return;
+		}
+
+		if (olc_BlitSprite(pDrawTarget, x, y, sprite, ox, oy, w, h, scale, flip, GetSpanBlitter(), 0, INT32_MAX))
+			olc_MarkDirty(x, y, x + w * int32_t(std::max(scale, 1u)), y + h * int32_t(std::max(scale, 1u)));
+		else
+			olc_RasterSprite(x, y, sprite, ox, oy, w, h, scale, flip, [&](int32_t px, int32_t py, Pixel p) { Draw(px, py, p); });
+	}
+
+	// Blits the rows y0 to y1, exclusive, of a sprite drawn at (x,y) a row at a
+	// time. Unscaled, unflipped rows are passed to the blitter straight from the
+	// sprite, so NORMAL mode is one memcpy per row. Other rows are gathered
+	// through a column table and widened by the scale first, once per source
+	// row. Returns false, having drawn nothing, when the pixels must go through
+	// Draw() or GetPixel() one by one: CUSTOM mode, a sprite drawn onto itself,
+	// or a source area reaching outside the sprite.
+	bool PixelGameEngine::olc_BlitSprite(Sprite* pTarget, int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip, const SpanBlitter& blit, int32_t y0, int32_t y1)
+	{
+		if (!blit.Copy || !pTarget || sprite == pTarget) return false;
+		if (w <= 0 || h <= 0) return true;
+		if (ox < 0 || oy < 0 || ox + w > sprite->width || oy + h > sprite->height) return false;
+
+		int32_t s = int32_t(std::max(scale, 1u));
+		bool bFlipH = flip & olc::Sprite::Flip::HORIZ, bFlipV = flip & olc::Sprite::Flip::VERT;
+		int32_t cx0 = std::max(x, 0), cx1 = std::min(x + w * s, pTarget->width);
+		int32_t cy0 = std::max({ y, y0, 0 }), cy1 = std::min({ y + h * s, y1, pTarget->height });
+		if (cx0 >= cx1 || cy0 >= cy1) return true;
+
+		// Source columns i0 to i1 of the area cover the visible columns
+		int32_t i0 = (cx0 - x) / s, i1 = (cx1 - 1 - x) / s, nCols = i1 - i0 + 1;
+		thread_local std::vector<int32_t> vecColumn;
+		thread_local std::vector<Pixel> vecGather, vecWide;
+		if (bFlipH)
+		{
+			vecColumn.resize(nCols);
+			vecGather.resize(nCols);
+			for (int32_t k = 0; k < nCols; k++) vecColumn[k] = w - 1 - (i0 + k);
+		}
+		if (s > 1) vecWide.resize(size_t(nCols) * s);
+
+		const Pixel* pRow = nullptr;
+		int32_t nRowSource = -1;
+		for (int32_t dy = cy0; dy < cy1; dy++)
+		{
+			int32_t j = (dy - y) / s;
+			int32_t sy = oy + (bFlipV ? h - 1 - j : j);
+			if (sy != nRowSource)
+			{
+				const Pixel* pSrc = sprite->pColData.data() + size_t(sy) * sprite->width + ox;
+				pRow = pSrc + i0;
+				if (bFlipH)
+				{
+					for (int32_t k = 0; k < nCols; k++) vecGather[k] = pSrc[vecColumn[k]];
+					pRow = vecGather.data();
+				}
+				if (s > 1)
+				{
+					span::Expand(vecWide.data(), pRow, nCols, uint32_t(s));
+					pRow = vecWide.data() + (cx0 - x) % s;
+				}
+				nRowSource = sy;
+			}
+			blit.Copy(pTarget->GetData() + size_t(dy) * pTarget->width + cx0, pRow, cx1 - cx0, blit.nBlend);
+		}
+		return true;
+	}
+
+	template<typename PLOT>
+	void PixelGameEngine::olc_RasterSprite(int32_t x, int32_t y, const Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip, PLOT&& plot)
+	{
 		int32_t fxs = 0, fxm = 1, fx = 0;
 		int32_t fys = 0, fym = 1, fy = 0;
 		if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
@@ -3103,7 +4374,7 @@ namespace olc
 				for (int32_t j = 0; j < h; j++, fy += fym)
 					for (uint32_t is = 0; is < scale; is++)
 						for (uint32_t js = 0; js < scale; js++)
-							Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
+							plot(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
 			}
 		}
 		else
@@ -3113,7 +4384,7 @@ namespace olc
 			{
 				fy = fys;
 				for (int32_t j = 0; j < h; j++, fy += fym)
-					Draw(x + i, y + j, sprite->GetPixel(fx + ox, fy + oy));
+					plot(x + i, y + j, sprite->GetPixel(fx + ox, fy + oy));
 			}
 		}
 	}
@@ -3713,9 +4984,34 @@ namespace olc
 	{ DrawString(pos.x, pos.y, sText, col, scale); }
 
 	void PixelGameEngine::DrawString(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale)
+	{ olc_DrawText(x, y, sText, col, scale, false); }
+
+	olc::vi2d PixelGameEngine::GetTextSizeProp(const std::string& s)
 	{
-		int32_t sx = 0;
-		int32_t sy = 0;
+		olc::vi2d size = { 0,1 };
+		olc::vi2d pos = { 0,1 };
+		for (auto c : s)
+		{
+			if (c == '\n') { pos.y += 1;  pos.x = 0; }
+			else if (c == '\t') { pos.x += nTabSizeInSpaces * 8; }
+			else pos.x += vFontSpacing[c - 32].y;
+			size.x = std::max(size.x, pos.x);
+			size.y = std::max(size.y, pos.y);
+		}
+
+		size.y *= 8;
+		return size;
+	}
+
+	void PixelGameEngine::DrawStringProp(const olc::vi2d& pos, const std::string& sText, Pixel col, uint32_t scale)
+	{ DrawStringProp(pos.x, pos.y, sText, col, scale); }
+
+	void PixelGameEngine::DrawStringProp(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale)
+	{ olc_DrawText(x, y, sText, col, scale, true); }
+
+	void PixelGameEngine::olc_DrawText(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale, bool bProp)
+	{
+		if (!pDrawTarget) return;
 		Pixel::Mode m = nPixelMode;
 		// Thanks @tucna, spotted bug with col.ALPHA :P
 		if (m != Pixel::CUSTOM) // Thanks @Megarev, required for "shaders"
@@ -3723,74 +5019,128 @@ namespace olc
 			if (col.a != 255)		SetPixelMode(Pixel::ALPHA);
 			else					SetPixelMode(Pixel::MASK);
 		}
+
+		if (nPixelMode == Pixel::CUSTOM)
+			olc_DrawTextPixels(x, y, sText, col, scale, bProp);
+		else
+		{
+			std::shared_ptr<const TextRuns> pRuns = olc_GetTextRuns(sText, scale, bProp);
+			olc_MarkDirty(x + pRuns->nLeft, y + pRuns->nTop, x + pRuns->nRight + 1, y + pRuns->nBottom + 1);
+			if (olc_RecordCommand())
+			{
+				DrawCommand cmd;
+				cmd.pTarget = pDrawTarget;
+				cmd.type = DrawCommand::Type::Text;
+				cmd.nMode = nPixelMode; cmd.nBlend = nBlendFactor;
+				cmd.x1 = x; cmd.y1 = y;
+				cmd.p = col;
+				cmd.nTop = y + pRuns->nTop; cmd.nBottom = y + pRuns->nBottom;
+				cmd.pText = std::move(pRuns);
+				vecCommands.push_back(std::move(cmd));
+			}
+			else
+				olc_FillTextRuns(pDrawTarget, x, y, *pRuns, col, GetSpanBlitter(), 0, pDrawTarget->height);
+		}
+		SetPixelMode(m);
+	}
+
+	// Glyphs never overlap, so each pixel of a string is written once and
+	// filling its runs gives the same result as drawing it pixel by pixel
+	std::shared_ptr<const PixelGameEngine::TextRuns> PixelGameEngine::olc_GetTextRuns(const std::string& sText, uint32_t scale, bool bProp)
+	{
+		// Scale 0 has always drawn glyphs at scale 1
+		scale = std::max(scale, 1u);
+		sTextRunsKey.assign(sText);
+		sTextRunsKey.push_back('\0');
+		sTextRunsKey.append(std::to_string(scale));
+		sTextRunsKey.push_back(bProp ? 'p' : 'm');
+		auto it = mapTextRuns.find(sTextRunsKey);
+		if (it != mapTextRuns.end())
+			return it->second;
+
+		// Labels rarely change, but numbers shown every frame would grow the
+		// cache without end, so it starts again once it is large
+		if (mapTextRuns.size() >= nTextRunsCacheSize)
+			mapTextRuns.clear();
+
+		auto pRuns = std::make_shared<TextRuns>();
+		int32_t sx = 0;
+		int32_t sy = 0;
+		int32_t s = int32_t(scale);
 		for (auto c : sText)
 		{
 			if (c == '\n')
 			{
-				sx = 0; sy += 8 * scale;
+				sx = 0; sy += 8 * s;
 			}
 			else if (c == '\t')
 			{
-				sx += 8 * nTabSizeInSpaces * scale;
+				sx += 8 * nTabSizeInSpaces * s;
 			}
-			else			
+			else
 			{
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
+				int32_t g = c - 32;
+				bool bGlyph = g >= 0 && g < 96;
+				if (bProp && !bGlyph) continue;
+				int32_t nStart = bProp ? vFontSpacing[g].x : 0;
+				int32_t nWidth = bProp ? vFontSpacing[g].y : 8;
 
-				if (scale > 1)
-				{
-					for (uint32_t i = 0; i < 8; i++)
-						for (uint32_t j = 0; j < 8; j++)
-							if (fontRenderable.Sprite()->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-								for (uint32_t is = 0; is < scale; is++)
-									for (uint32_t js = 0; js < scale; js++)
-										Draw(x + sx + (i * scale) + is, y + sy + (j * scale) + js, col);
-				}
-				else
+				for (int32_t j = 0; bGlyph && j < 8; j++)
 				{
-					for (uint32_t i = 0; i < 8; i++)
-						for (uint32_t j = 0; j < 8; j++)
-							if (fontRenderable.Sprite()->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-								Draw(x + sx + i, y + sy + j, col);
+					uint32_t nBits = (nGlyphRows[g * 8 + j] >> nStart) & ((1u << nWidth) - 1);
+					for (int32_t i = 0; nBits != 0;)
+					{
+						// Skip to the next run of set columns and measure it
+						while (!(nBits & 1)) { nBits >>= 1; i++; }
+						int32_t n = 0;
+						while (nBits & 1) { nBits >>= 1; n++; }
+						for (int32_t js = 0; js < s; js++)
+							pRuns->vecRuns.push_back({ sx + i * s, sy + j * s + js, n * s });
+						i += n;
+					}
 				}
-				sx += 8 * scale;
+				sx += nWidth * s;
 			}
 		}
-		SetPixelMode(m);
+
+		if (!pRuns->vecRuns.empty())
+		{
+			const TextRun& first = pRuns->vecRuns.front();
+			pRuns->nTop = pRuns->nBottom = first.y;
+			pRuns->nLeft = first.x;
+			pRuns->nRight = first.x + first.n - 1;
+		}
+		for (auto& run : pRuns->vecRuns)
+		{
+			pRuns->nTop = std::min(pRuns->nTop, run.y);
+			pRuns->nBottom = std::max(pRuns->nBottom, run.y);
+			pRuns->nLeft = std::min(pRuns->nLeft, run.x);
+			pRuns->nRight = std::max(pRuns->nRight, run.x + run.n - 1);
+		}
+		mapTextRuns.emplace(sTextRunsKey, pRuns);
+		return pRuns;
 	}
 
-	olc::vi2d PixelGameEngine::GetTextSizeProp(const std::string& s)
+	// Fills the runs of a string at (x,y) that fall in rows y0 to y1, exclusive
+	void PixelGameEngine::olc_FillTextRuns(Sprite* pTarget, int32_t x, int32_t y, const TextRuns& runs, Pixel col, const SpanBlitter& blit, int32_t y0, int32_t y1)
 	{
-		olc::vi2d size = { 0,1 };
-		olc::vi2d pos = { 0,1 };
-		for (auto c : s)
+		y0 = std::max(y0, 0);
+		y1 = std::min(y1, pTarget->height);
+		for (const auto& run : runs.vecRuns)
 		{
-			if (c == '\n') { pos.y += 1;  pos.x = 0; }
-			else if (c == '\t') { pos.x += nTabSizeInSpaces * 8; }
-			else pos.x += vFontSpacing[c - 32].y;
-			size.x = std::max(size.x, pos.x);
-			size.y = std::max(size.y, pos.y);
+			int32_t py = y + run.y;
+			if (py < y0 || py >= y1) continue;
+			int32_t x1 = std::max(x + run.x, 0), x2 = std::min(x + run.x + run.n, pTarget->width);
+			if (x1 < x2)
+				blit.Fill(pTarget->GetData() + size_t(py) * pTarget->width + x1, x2 - x1, col, blit.nBlend);
 		}
-
-		size.y *= 8;
-		return size;
 	}
 
-	void PixelGameEngine::DrawStringProp(const olc::vi2d& pos, const std::string& sText, Pixel col, uint32_t scale)
-	{ DrawStringProp(pos.x, pos.y, sText, col, scale); }
-
-	void PixelGameEngine::DrawStringProp(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale)
+	// Text in CUSTOM pixel mode, one Draw() per pixel
+	void PixelGameEngine::olc_DrawTextPixels(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale, bool bProp)
 	{
 		int32_t sx = 0;
 		int32_t sy = 0;
-		Pixel::Mode m = nPixelMode;
-
-		if (m != Pixel::CUSTOM)
-		{
-			if (col.a != 255)		SetPixelMode(Pixel::ALPHA);
-			else					SetPixelMode(Pixel::MASK);
-		}
 		for (auto c : sText)
 		{
 			if (c == '\n')
@@ -3805,27 +5155,167 @@ namespace olc
 			{
 				int32_t ox = (c - 32) % 16;
 				int32_t oy = (c - 32) / 16;
+				int32_t nStart = bProp ? vFontSpacing[c - 32].x : 0;
+				int32_t nWidth = bProp ? vFontSpacing[c - 32].y : 8;
 
 				if (scale > 1)
 				{
-					for (int32_t i = 0; i < vFontSpacing[c - 32].y; i++)
+					for (int32_t i = 0; i < nWidth; i++)
 						for (int32_t j = 0; j < 8; j++)
-							if (fontRenderable.Sprite()->GetPixel(i + ox * 8 + vFontSpacing[c - 32].x, j + oy * 8).r > 0)
+							if (fontRenderable.Sprite()->GetPixel(i + ox * 8 + nStart, j + oy * 8).r > 0)
 								for (int32_t is = 0; is < int(scale); is++)
 									for (int32_t js = 0; js < int(scale); js++)
 										Draw(x + sx + (i * scale) + is, y + sy + (j * scale) + js, col);
 				}
 				else
 				{
-					for (int32_t i = 0; i < vFontSpacing[c - 32].y; i++)
+					for (int32_t i = 0; i < nWidth; i++)
 						for (int32_t j = 0; j < 8; j++)
-							if (fontRenderable.Sprite()->GetPixel(i + ox * 8 + vFontSpacing[c - 32].x, j + oy * 8).r > 0)
+							if (fontRenderable.Sprite()->GetPixel(i + ox * 8 + nStart, j + oy * 8).r > 0)
 								Draw(x + sx + i, y + sy + j, col);
 				}
-				sx += vFontSpacing[c - 32].y * scale;
+				sx += nWidth * scale;
 			}
 		}
-		SetPixelMode(m);
+	}
+
+	void PixelGameEngine::EnableCommandBuffer(bool bEnable, uint32_t nThreads)
+	{
+		FlushCommands();
+		if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+		if (nThreads != nRasterThreads) olc_StopRasterWorkers();
+		nRasterThreads = nThreads;
+		bCommandBuffer = bEnable;
+	}
+
+	bool PixelGameEngine::olc_RecordCommand(const olc::Sprite* pSource, bool bUsesPixelMode)
+	{
+		if (!bCommandBuffer || pDrawTarget == nullptr || (bUsesPixelMode && nPixelMode == Pixel::CUSTOM) || pSource == pDrawTarget)
+		{
+			FlushCommands();
+			return false;
+		}
+
+		// Tiles run in parallel, so no sprite may be both read and written by
+		// what is pending: one tile could read rows another is still drawing
+		auto Pending = [](const std::vector<const olc::Sprite*>& vec, const olc::Sprite* spr)
+		{ return std::find(vec.begin(), vec.end(), spr) != vec.end(); };
+		if (Pending(vecCommandSources, pDrawTarget) || (pSource && Pending(vecCommandTargets, pSource)))
+			FlushCommands();
+		if (!Pending(vecCommandTargets, pDrawTarget)) vecCommandTargets.push_back(pDrawTarget);
+		if (pSource && !Pending(vecCommandSources, pSource)) vecCommandSources.push_back(pSource);
+		return true;
+	}
+
+	void PixelGameEngine::FlushCommands()
+	{
+		if (vecCommands.empty()) return;
+
+		// Bin each command into every tile of rows it touches
+		int32_t nRows = 0;
+		for (auto& cmd : vecCommands) nRows = std::max(nRows, cmd.pTarget->height);
+		size_t nTiles = size_t((nRows + nCommandTileHeight - 1) / nCommandTileHeight);
+		if (vecTileCommands.size() < nTiles) vecTileCommands.resize(nTiles);
+		for (auto& tile : vecTileCommands) tile.clear();
+		for (uint32_t i = 0; i < uint32_t(vecCommands.size()); i++)
+		{
+			const DrawCommand& cmd = vecCommands[i];
+			int32_t nTop = std::max(cmd.nTop, 0), nBottom = std::min(cmd.nBottom, cmd.pTarget->height - 1);
+			for (int32_t t = nTop / nCommandTileHeight; nTop <= nBottom && t <= nBottom / nCommandTileHeight; t++)
+				vecTileCommands[t].push_back(i);
+		}
+
+		nNextTile = 0;
+		if (nRasterThreads > 1 && nTiles > 1)
+		{
+			if (vecRasterWorkers.empty())
+				for (uint32_t i = 1; i < nRasterThreads; i++)
+					vecRasterWorkers.emplace_back(&PixelGameEngine::olc_RasterWorker, this, nRasterBatch);
+
+			{
+				std::lock_guard<std::mutex> lock(muxRaster);
+				nRasterBusy = uint32_t(vecRasterWorkers.size());
+				nRasterBatch++;
+			}
+			cvRasterWork.notify_all();
+			olc_RasterTiles();
+			std::unique_lock<std::mutex> lock(muxRaster);
+			cvRasterDone.wait(lock, [&] { return nRasterBusy == 0; });
+		}
+		else
+			olc_RasterTiles();
+
+		vecCommands.clear();
+		vecCommandTargets.clear();
+		vecCommandSources.clear();
+	}
+
+	void PixelGameEngine::olc_RasterTiles()
+	{
+		for (size_t t = nNextTile++; t < vecTileCommands.size(); t = nNextTile++)
+			for (uint32_t i : vecTileCommands[t])
+				olc_RasterCommand(vecCommands[i], int32_t(t) * nCommandTileHeight, int32_t(t + 1) * nCommandTileHeight);
+	}
+
+	// Draws the part of a command that falls in rows y0 to y1, exclusive
+	void PixelGameEngine::olc_RasterCommand(const DrawCommand& cmd, int32_t y0, int32_t y1)
+	{
+		Sprite* pTarget = cmd.pTarget;
+		auto plot = [&](int32_t x, int32_t y, Pixel p)
+		{
+			if (y >= y0 && y < y1) span::Plot(pTarget, x, y, p, cmd.nMode, cmd.nBlend);
+		};
+
+		switch (cmd.type)
+		{
+		case DrawCommand::Type::FillRect:
+		{
+			SpanBlitter blit = span::Blitter(cmd.nMode, cmd.nBlend);
+			int32_t ya = std::max(cmd.y1, y0), yb = std::min(cmd.y2, y1);
+			Pixel* pRow = pTarget->GetData() + size_t(ya) * pTarget->width + cmd.x1;
+			for (int32_t j = ya; j < yb; j++, pRow += pTarget->width)
+				blit.Fill(pRow, cmd.x2 - cmd.x1, cmd.p, blit.nBlend);
+			break;
+		}
+		case DrawCommand::Type::Line:
+			olc_RasterLine(cmd.x1, cmd.y1, cmd.x2, cmd.y2, cmd.p, cmd.nParam, plot);
+			break;
+		case DrawCommand::Type::Sprite:
+			if (!olc_BlitSprite(pTarget, cmd.x1, cmd.y1, cmd.pSprite, cmd.ox, cmd.oy, cmd.w, cmd.h, cmd.nParam, cmd.nFlip, span::Blitter(cmd.nMode, cmd.nBlend), y0, y1))
+				olc_RasterSprite(cmd.x1, cmd.y1, cmd.pSprite, cmd.ox, cmd.oy, cmd.w, cmd.h, cmd.nParam, cmd.nFlip, plot);
+			break;
+		case DrawCommand::Type::Text:
+			olc_FillTextRuns(pTarget, cmd.x1, cmd.y1, *cmd.pText, cmd.p, span::Blitter(cmd.nMode, cmd.nBlend), y0, y1);
+			break;
+		}
+	}
+
+	// Rasterizes each batch after nSeen once, alongside the flushing thread
+	void PixelGameEngine::olc_RasterWorker(uint64_t nSeen)
+	{
+		std::unique_lock<std::mutex> lock(muxRaster);
+		while (true)
+		{
+			cvRasterWork.wait(lock, [&] { return bRasterQuit || nRasterBatch != nSeen; });
+			if (bRasterQuit) return;
+			nSeen = nRasterBatch;
+			lock.unlock();
+			olc_RasterTiles();
+			lock.lock();
+			if (--nRasterBusy == 0) cvRasterDone.notify_one();
+		}
+	}
+
+	void PixelGameEngine::olc_StopRasterWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(muxRaster);
+			bRasterQuit = true;
+		}
+		cvRasterWork.notify_all();
+		for (auto& worker : vecRasterWorkers) worker.join();
+		vecRasterWorkers.clear();
+		bRasterQuit = false;
 	}
 
 	void PixelGameEngine::SetPixelMode(Pixel::Mode m)
@@ -3845,8 +5335,12 @@ namespace olc
 		fBlendFactor = fBlend;
 		if (fBlendFactor < 0.0f) fBlendFactor = 0.0f;
 		if (fBlendFactor > 1.0f) fBlendFactor = 1.0f;
+		nBlendFactor = uint32_t(fBlendFactor * 255.0f + 0.5f);
 	}
 
+	SpanBlitter PixelGameEngine::GetSpanBlitter() const
+	{ return span::Blitter(nPixelMode, nBlendFactor); }
+
 	std::stringstream& PixelGameEngine::ConsoleOut()
 	{ return ssConsoleOutput; }
 
@@ -4237,8 +5731,9 @@ namespace olc
 		vLayers[0].bShow = true;
 		SetDrawTarget(nullptr);
 
-		m_tp1 = std::chrono::system_clock::now();
-		m_tp2 = std::chrono::system_clock::now();
+		m_tp1 = std::chrono::steady_clock::now();
+		m_tp2 = std::chrono::steady_clock::now();
+		tpNextFrame = tpLastDrawn = m_tp2;
 	}
 
 
@@ -4278,6 +5773,7 @@ namespace olc
 				{
 					layer.pDrawTarget.Decal()->Update();
 					layer.bUpdate = false;
+					layer.dirty.vecRects.clear();
 				}
 
 				// Can't use this as it assumes full screen coords
@@ -4328,21 +5824,50 @@ namespace olc
 
 	void PixelGameEngine::olc_CoreUpdate()
 	{
+		// Some platforms will need to check for events
+		platform->HandleSystemEvent();
+
+		// Idle frames are skipped whole, polling input at the frame cap or
+		// 60Hz, and only sleeping as a late poll does not matter
+		auto tpNow = std::chrono::steady_clock::now();
+		float fPollPeriod = fFrameCap > 0.0f ? fFrameCap : 1.0f / 60.0f;
+		if (bRedrawOnChange && !bRedrawRequested.exchange(false) && !olc_InputChanged()
+			&& std::chrono::duration<float>(tpNow - tpLastDrawn).count() < fMaxIdle)
+		{
+			frameStats.nSkipped++;
+			olc_PaceFrame(fPollPeriod, 0.0f);
+			return;
+		}
+		tpLastDrawn = tpNow;
+
 		// Handle Timing
-		m_tp2 = std::chrono::system_clock::now();
+		m_tp2 = tpNow;
 		std::chrono::duration<float> elapsedTime = m_tp2 - m_tp1;
 		m_tp1 = m_tp2;
 
 		// Our time per frame coefficient
 		float fElapsedTime = elapsedTime.count();
+		// Whatever woke a skipping app happened since the last poll, so held
+		// keys and animations don't jump by the whole idle stretch
+		if (frameStats.nSkipped != nStatsSkipped)
+			fElapsedTime = std::min(fElapsedTime, fPollPeriod);
 		fLastElapsed = fElapsedTime;
 
+		// Intervals spanning skipped frames say nothing about pacing
+		if (frameStats.nFrames > 0 && frameStats.nSkipped == nStatsSkipped)
+		{
+			float fTarget = fFrameCap > 0.0f ? fFrameCap : frameStats.fAverage;
+			frameStats.fInterval = fElapsedTime;
+			frameStats.fAverage += (fElapsedTime - frameStats.fAverage) * 0.05f;
+			frameStats.fJitter += (std::abs(fElapsedTime - fTarget) - frameStats.fJitter) * 0.05f;
+			fWorstThisSecond = std::max(fWorstThisSecond, fElapsedTime);
+		}
+		nStatsSkipped = frameStats.nSkipped;
+		frameStats.nFrames++;
+
 		if (bConsoleSuspendTime)
 			fElapsedTime = 0.0f;
 
-		// Some platforms will need to check for events
-		platform->HandleSystemEvent();
-
 		// Compare hardware input states from previous frame
 		auto ScanHardware = [&](HWButton* pKeys, bool* pStateOld, bool* pStateNew, uint32_t nKeyCount)
 		{
@@ -4390,7 +5915,7 @@ namespace olc
 		if (!bExtensionBlockFrame)
 		{
 			if (!OnUserUpdate(fElapsedTime)) bAtomActive = false;
-			
+			FlushCommands();
 		}
 		for (auto& ext : vExtensions) ext->OnAfterUserUpdate(fElapsedTime);
 
@@ -4416,7 +5941,6 @@ namespace olc
 			renderer->ClearBuffer(olc::BLACK, true);
 
 			// Layer 0 must always exist
-			vLayers[0].bUpdate = true;
 			vLayers[0].bShow = true;
 			SetDecalMode(DecalMode::NORMAL);
 			renderer->PrepareDrawing();
@@ -4428,10 +5952,19 @@ namespace olc
 					if (layer->funcHook == nullptr)
 					{
 						renderer->ApplyTexture(layer->pDrawTarget.Decal()->id);
-						if (!bSuspendTextureTransfer && layer->bUpdate)
+						if (!bSuspendTextureTransfer)
 						{
-							layer->pDrawTarget.Decal()->Update();
+							// Only what was drawn on since the last upload is sent
+							bool bWhole = layer->bUpdate;
+							for (size_t i = 0; !bWhole && i < layer->dirty.vecRects.size(); i++)
+							{
+								auto& rect = layer->dirty.vecRects[i];
+								bWhole = !renderer->UpdateTextureRegion(layer->pDrawTarget.Decal()->id, layer->pDrawTarget.Sprite(), rect.first, rect.second - rect.first);
+							}
+							if (bWhole)
+								layer->pDrawTarget.Decal()->Update();
 							layer->bUpdate = false;
+							layer->dirty.vecRects.clear();
 						}
 
 						renderer->DrawLayerQuad(layer->vOffset, layer->vScale, layer->tint);
@@ -4452,6 +5985,9 @@ namespace olc
 
 		// Present Graphics to screen
 		renderer->DisplayFrame();
+		if (funcFrameCallback)
+			if (const olc::Sprite* pFrame = renderer->GetFrameBuffer())
+				funcFrameCallback(*pFrame);
 
 		if (bResizeRequested)
 		{
@@ -4466,11 +6002,53 @@ namespace olc
 		if (fFrameTimer >= 1.0f)
 		{
 			nLastFPS = nFrameCount;
+			frameStats.fWorst = fWorstThisSecond;
+			fWorstThisSecond = 0.0f;
 			fFrameTimer -= 1.0f;
 			std::string sTitle = "OneLoneCoder.com - Pixel Game Engine - " + sAppName + " - FPS: " + std::to_string(nFrameCount);
 			platform->SetWindowTitle(sTitle);
 			nFrameCount = 0;
 		}
+
+		frameStats.fWork += (std::chrono::duration<float>(std::chrono::steady_clock::now() - tpNow).count() - frameStats.fWork) * 0.05f;
+		olc_PaceFrame(fFrameCap, fFrameSpin);
+	}
+
+	// Anything that would show on the next frame. Held keys and buttons count
+	// too, since apps scroll or drag for as long as they are down.
+	bool PixelGameEngine::olc_InputChanged() const
+	{
+		for (uint32_t i = 0; i < 256; i++)
+			if (pKeyNewState[i] || pKeyOldState[i]) return true;
+		for (uint32_t i = 0; i < nMouseButtons; i++)
+			if (pMouseNewState[i] || pMouseOldState[i]) return true;
+		return vMousePosCache != vMousePos || nMouseWheelDeltaCache != 0 || !vDroppedFilesCache.empty()
+			|| bResizeRequested || bTextEntryEnable || bConsoleShow;
+	}
+
+	// Waits until fPeriod after the last frame was due, spinning for the last
+	// fSpin seconds. A frame more than a period late restarts the schedule
+	// from now rather than hurrying the next ones to catch up.
+	void PixelGameEngine::olc_PaceFrame(float fPeriod, float fSpin)
+	{
+		using clock = std::chrono::steady_clock;
+		auto tpNow = clock::now();
+		if (fPeriod <= 0.0f)
+		{
+			tpNextFrame = tpNow;
+			return;
+		}
+
+		auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(fPeriod));
+		tpNextFrame += period;
+		if (tpNextFrame + period < tpNow)
+			tpNextFrame = tpNow;
+
+		auto tpSpin = tpNextFrame - std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(fSpin));
+		if (tpNow < tpSpin)
+			std::this_thread::sleep_until(tpSpin);
+		while (clock::now() < tpNextFrame)
+			std::this_thread::yield();
 	}
 
 	void PixelGameEngine::olc_ConstructFontSheet()
@@ -4524,6 +6102,16 @@ namespace olc
 
 		for (auto c : vSpacing) vFontSpacing.push_back({ c >> 4, c & 15 });
 
+		for (int32_t g = 0; g < 96; g++)
+			for (int32_t j = 0; j < 8; j++)
+			{
+				uint8_t nBits = 0;
+				for (int32_t i = 0; i < 8; i++)
+					if (fontRenderable.Sprite()->GetPixel((g % 16) * 8 + i, (g / 16) * 8 + j).r > 0) nBits |= uint8_t(1 << i);
+				nGlyphRows[g * 8 + j] = nBits;
+			}
+		mapTextRuns.clear();
+
 		// UK Standard Layout
 #ifdef OLC_KEYBOARD_UK
 		vKeyboardMap =
@@ -4580,24 +6168,344 @@ namespace olc
 namespace olc
 {
 #if defined(OLC_GFX_HEADLESS)
+	// Stands in for the GPU by compositing layers and decals into a frame in
+	// memory, as the OpenGL 1.0 renderer would draw them. Textures are copies
+	// of their sprites taken on upload, sampled nearest or bilinear with 8
+	// bit weights, and blending is integer. Frames are always opaque.
 	class Renderer_Headless : public olc::Renderer
 	{
+	private:
+		struct Texture
+		{
+			olc::Sprite sprite;
+			bool bFiltered = false;
+			bool bClamp = true;
+		};
+
+		// A decal vertex in frame pixels
+		struct Vertex
+		{
+			float x, y, z, u, v, q;
+			olc::Pixel tint;
+		};
+
+		std::unordered_map<uint32_t, std::unique_ptr<Texture>> mapTextures;
+		uint32_t nAppliedTexture = 0;
+		olc::Sprite sprFrame;
+		std::vector<float> vecDepth;
+		olc::vi2d vViewPos = { 0, 0 };
+		olc::vi2d vViewSize = { 0, 0 };
+		olc::DecalMode nDecalMode = olc::DecalMode::NORMAL;
+		bool bDepthTest = false;
+
+		Texture* FindTexture(uint32_t id) const
+		{
+			auto it = mapTextures.find(id);
+			return it == mapTextures.end() || it->second->sprite.width == 0 ? nullptr : it->second.get();
+		}
+
+		// The frame follows the window size
+		void SizeFrame()
+		{
+			olc::vi2d vSize = ptrPGE->GetWindowSize();
+			if (vSize.x == sprFrame.width && vSize.y == sprFrame.height) return;
+			sprFrame.SetSize(vSize.x, vSize.y);
+			vecDepth.assign(size_t(vSize.x) * vSize.y, 1.0f);
+		}
+
+		static int32_t Wrap(int32_t i, int32_t n, bool bClamp)
+		{
+			if (bClamp) return std::max(0, std::min(i, n - 1));
+			i %= n;
+			return i < 0 ? i + n : i;
+		}
+
+		static olc::Pixel Fetch(const Texture* t, float u, float v)
+		{
+			if (t == nullptr) return olc::WHITE;
+			const olc::Sprite& spr = t->sprite;
+			if (!t->bFiltered)
+				return spr.pColData[size_t(Wrap(int32_t(std::floor(u * spr.width)), spr.width, t->bClamp))
+					+ size_t(Wrap(int32_t(std::floor(v * spr.height)), spr.height, t->bClamp)) * spr.width];
+			float fu = u * spr.width - 0.5f, fv = v * spr.height - 0.5f;
+			float x = std::floor(fu), y = std::floor(fv);
+			int32_t x0 = Wrap(int32_t(x), spr.width, t->bClamp), x1 = Wrap(int32_t(x) + 1, spr.width, t->bClamp);
+			int32_t y0 = Wrap(int32_t(y), spr.height, t->bClamp), y1 = Wrap(int32_t(y) + 1, spr.height, t->bClamp);
+			const olc::Pixel* p = spr.pColData.data();
+			return sample::Blend(p[size_t(y0) * spr.width + x0], p[size_t(y0) * spr.width + x1], p[size_t(y1) * spr.width + x0], p[size_t(y1) * spr.width + x1],
+				uint32_t((fu - x) * 256.0f), uint32_t((fv - y) * 256.0f));
+		}
+
+		static olc::Pixel Modulate(olc::Pixel p, olc::Pixel tint)
+		{
+			return olc::Pixel(uint8_t(span::Div255(p.r * tint.r)), uint8_t(span::Div255(p.g * tint.g)), uint8_t(span::Div255(p.b * tint.b)), uint8_t(span::Div255(p.a * tint.a)));
+		}
+
+		// The blend functions SetDecalMode() picks in the OpenGL renderers
+		olc::Pixel Blend(olc::Pixel s, olc::Pixel d) const
+		{
+			uint32_t a = s.a, c = 255 - a;
+			auto Mix = [&](uint32_t sc, uint32_t dc) -> uint8_t
+			{
+				switch (nDecalMode)
+				{
+				case olc::DecalMode::ADDITIVE: return uint8_t(std::min(255u, span::Div255(sc * a) + dc));
+				case olc::DecalMode::MULTIPLICATIVE: return uint8_t(std::min(255u, span::Div255(sc * dc) + span::Div255(dc * c)));
+				case olc::DecalMode::STENCIL: return uint8_t(span::Div255(dc * a));
+				case olc::DecalMode::ILLUMINATE: return uint8_t(std::min(255u, span::Div255(sc * c) + span::Div255(dc * a)));
+				default: return uint8_t(span::Div255(sc * a + dc * c));
+				}
+			};
+			return olc::Pixel(Mix(s.r, d.r), Mix(s.g, d.g), Mix(s.b, d.b));
+		}
+
+		void Plot(int32_t x, int32_t y, const Vertex& p, const Texture* t)
+		{
+			if (x < vViewPos.x || y < vViewPos.y || x >= vViewPos.x + vViewSize.x || y >= vViewPos.y + vViewSize.y) return;
+			if (x >= sprFrame.width || y >= sprFrame.height || x < 0 || y < 0) return;
+			size_t i = size_t(y) * sprFrame.width + x;
+			if (bDepthTest)
+			{
+				if (!(p.z < vecDepth[i])) return;
+				vecDepth[i] = p.z;
+			}
+			olc::Pixel& d = sprFrame.pColData[i];
+			d = Blend(Modulate(Fetch(t, p.u / p.q, p.v / p.q), p.tint), d);
+		}
+
+		static Vertex Lerp(const Vertex& a, const Vertex& b, const Vertex& c, float l0, float l1, float l2)
+		{
+			auto Channel = [&](uint8_t x, uint8_t y, uint8_t z) { return uint8_t(std::min(255.0f, x * l0 + y * l1 + z * l2 + 0.5f)); };
+			return { 0.0f, 0.0f, a.z * l0 + b.z * l1 + c.z * l2, a.u * l0 + b.u * l1 + c.u * l2, a.v * l0 + b.v * l1 + c.v * l2, a.q * l0 + b.q * l1 + c.q * l2,
+				olc::Pixel(Channel(a.tint.r, b.tint.r, c.tint.r), Channel(a.tint.g, b.tint.g, c.tint.g), Channel(a.tint.b, b.tint.b, c.tint.b), Channel(a.tint.a, b.tint.a, c.tint.a)) };
+		}
+
+		// Pixels whose centres are inside, with shared edges owned by the
+		// triangle they are the top or left edge of, as on a GPU
+		void FillTriangle(const Vertex& a, Vertex b, Vertex c, const Texture* t)
+		{
+			auto Edge = [](const Vertex& p, const Vertex& q, float x, float y) { return (q.x - p.x) * (y - p.y) - (q.y - p.y) * (x - p.x); };
+			float fArea = Edge(a, b, c.x, c.y);
+			if (fArea == 0.0f) return;
+			if (fArea < 0.0f)
+			{
+				std::swap(b, c);
+				fArea = -fArea;
+			}
+			auto TopLeft = [](const Vertex& p, const Vertex& q) { return (q.y == p.y && q.x > p.x) || q.y < p.y; };
+			auto Inside = [](float w, bool bTopLeft) { return w > 0.0f || (w == 0.0f && bTopLeft); };
+			bool bTL0 = TopLeft(b, c), bTL1 = TopLeft(c, a), bTL2 = TopLeft(a, b);
+
+			int32_t x0 = std::max(vViewPos.x, int32_t(std::floor(std::min({ a.x, b.x, c.x }))));
+			int32_t x1 = std::min(vViewPos.x + vViewSize.x - 1, int32_t(std::ceil(std::max({ a.x, b.x, c.x }))));
+			int32_t y0 = std::max(vViewPos.y, int32_t(std::floor(std::min({ a.y, b.y, c.y }))));
+			int32_t y1 = std::min(vViewPos.y + vViewSize.y - 1, int32_t(std::ceil(std::max({ a.y, b.y, c.y }))));
+			x0 = std::max(x0, 0); y0 = std::max(y0, 0);
+			x1 = std::min(x1, sprFrame.width - 1); y1 = std::min(y1, sprFrame.height - 1);
+
+			// Flat untextured triangles, such as batched rectangles, are
+			// blended a row at a time, each row's pixels being contiguous
+			bool bFlat = t == nullptr && !bDepthTest && nDecalMode == olc::DecalMode::NORMAL && a.tint == b.tint && a.tint == c.tint;
+			olc::SpanBlitter blit = span::Blitter(olc::Pixel::ALPHA, 255);
+			for (int32_t y = y0; y <= y1; y++)
+			{
+				int32_t nFirst = -1, nLast = -1;
+				for (int32_t x = x0; x <= x1; x++)
+				{
+					float px = float(x) + 0.5f, py = float(y) + 0.5f;
+					float w0 = Edge(b, c, px, py), w1 = Edge(c, a, px, py), w2 = Edge(a, b, px, py);
+					if (!(Inside(w0, bTL0) && Inside(w1, bTL1) && Inside(w2, bTL2)))
+					{
+						if (nFirst >= 0) break;
+						continue;
+					}
+					if (nFirst < 0) nFirst = x;
+					nLast = x;
+					if (!bFlat) Plot(x, y, Lerp(a, b, c, w0 / fArea, w1 / fArea, w2 / fArea), t);
+				}
+				if (bFlat && nFirst >= 0)
+					blit.Fill(&sprFrame.pColData[size_t(y) * sprFrame.width + nFirst], nLast - nFirst + 1, a.tint, 255);
+			}
+		}
+
+		void DrawLine(const Vertex& a, const Vertex& b, const Texture* t)
+		{
+			int32_t x0 = int32_t(std::floor(a.x)), y0 = int32_t(std::floor(a.y));
+			int32_t x1 = int32_t(std::floor(b.x)), y1 = int32_t(std::floor(b.y));
+			int32_t n = std::max(std::abs(x1 - x0), std::abs(y1 - y0));
+			for (int32_t i = 0; i <= n; i++)
+			{
+				float f = n == 0 ? 0.0f : float(i) / float(n);
+				Plot(x0 + int32_t(std::lround(f * (x1 - x0))), y0 + int32_t(std::lround(f * (y1 - y0))), Lerp(a, b, b, 1.0f - f, f, 0.0f), t);
+			}
+		}
+
 	public:
 		virtual void       PrepareDevice() {};
 		virtual olc::rcode CreateDevice(std::vector<void*> params, bool bFullScreen, bool bVSYNC) { return olc::rcode::OK;		}
 		virtual olc::rcode DestroyDevice() { return olc::rcode::OK; }
 		virtual void       DisplayFrame() {}
-		virtual void       PrepareDrawing() {}
-		virtual void	   SetDecalMode(const olc::DecalMode& mode) {}
-		virtual void       DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint) {}
-		virtual void       DrawDecal(const olc::DecalInstance& decal) {}
-		virtual uint32_t   CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) {return 1;};
-		virtual void       UpdateTexture(uint32_t id, olc::Sprite* spr) {}
-		virtual void       ReadTexture(uint32_t id, olc::Sprite* spr) {}
-		virtual uint32_t   DeleteTexture(const uint32_t id) {return 1;}
-		virtual void       ApplyTexture(uint32_t id) {}
-		virtual void       UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size) {}
-		virtual void       ClearBuffer(olc::Pixel p, bool bDepth) {}
+
+		virtual void PrepareDrawing()
+		{
+			SizeFrame();
+			nDecalMode = olc::DecalMode::NORMAL;
+		}
+
+		virtual void SetDecalMode(const olc::DecalMode& mode)
+		{ nDecalMode = mode; }
+
+		// The applied texture across the viewport. Untinted nearest layers,
+		// the usual case, are blended a row at a time.
+		virtual void DrawLayerQuad(const olc::vf2d& offset, const olc::vf2d& scale, const olc::Pixel tint)
+		{
+			const Texture* t = FindTexture(nAppliedTexture);
+			int32_t x0 = std::max(vViewPos.x, 0), x1 = std::min(vViewPos.x + vViewSize.x, sprFrame.width);
+			int32_t y0 = std::max(vViewPos.y, 0), y1 = std::min(vViewPos.y + vViewSize.y, sprFrame.height);
+			if (t == nullptr || x0 >= x1 || y0 >= y1) return;
+
+			auto U = [&](int32_t x) { return (float(x - vViewPos.x) + 0.5f) / float(vViewSize.x) * scale.x + offset.x; };
+			auto V = [&](int32_t y) { return (float(y - vViewPos.y) + 0.5f) / float(vViewSize.y) * scale.y + offset.y; };
+			if (!t->bFiltered && tint == olc::WHITE && nDecalMode == olc::DecalMode::NORMAL)
+			{
+				std::vector<int32_t> vecColumns(x1 - x0);
+				for (int32_t x = x0; x < x1; x++)
+					vecColumns[x - x0] = Wrap(int32_t(std::floor(U(x) * t->sprite.width)), t->sprite.width, t->bClamp);
+				std::vector<olc::Pixel> vecRow(x1 - x0);
+				olc::SpanBlitter blit = span::Blitter(olc::Pixel::ALPHA, 255);
+				for (int32_t y = y0; y < y1; y++)
+				{
+					const olc::Pixel* pSource = &t->sprite.pColData[size_t(Wrap(int32_t(std::floor(V(y) * t->sprite.height)), t->sprite.height, t->bClamp)) * t->sprite.width];
+					for (size_t i = 0; i < vecColumns.size(); i++) vecRow[i] = pSource[vecColumns[i]];
+					blit.Copy(&sprFrame.pColData[size_t(y) * sprFrame.width + x0], vecRow.data(), x1 - x0, 255);
+				}
+				return;
+			}
+
+			bool bDepth = bDepthTest;
+			bDepthTest = false;
+			for (int32_t y = y0; y < y1; y++)
+				for (int32_t x = x0; x < x1; x++)
+					Plot(x, y, { 0.0f, 0.0f, 0.0f, U(x), V(y), 1.0f, tint }, t);
+			bDepthTest = bDepth;
+		}
+
+		virtual void DrawDecal(const olc::DecalInstance& decal)
+		{
+			SetDecalMode(decal.mode);
+			const Texture* t = decal.decal == nullptr ? nullptr : FindTexture(decal.decal->id);
+			bDepthTest = decal.depth;
+
+			std::vector<Vertex> vecVerts(decal.points);
+			for (uint32_t n = 0; n < decal.points; n++)
+			{
+				vecVerts[n].x = float(vViewPos.x) + (decal.pos[n].x + 1.0f) * 0.5f * float(vViewSize.x);
+				vecVerts[n].y = float(vViewPos.y) + (1.0f - decal.pos[n].y) * 0.5f * float(vViewSize.y);
+				vecVerts[n].z = decal.depth ? decal.z[n] : 0.0f;
+				vecVerts[n].u = decal.uv[n].x;
+				vecVerts[n].v = decal.uv[n].y;
+				vecVerts[n].q = decal.w[n];
+				vecVerts[n].tint = decal.tint[n];
+			}
+
+			if (nDecalMode == olc::DecalMode::WIREFRAME)
+			{
+				for (uint32_t n = 0; n < decal.points; n++)
+					DrawLine(vecVerts[n], vecVerts[(n + 1) % decal.points], t);
+			}
+			else if (decal.structure == olc::DecalStructure::LINE)
+			{
+				for (uint32_t n = 1; n < decal.points; n++)
+					DrawLine(vecVerts[n - 1], vecVerts[n], t);
+			}
+			else if (decal.structure == olc::DecalStructure::FAN)
+			{
+				for (uint32_t n = 2; n < decal.points; n++)
+					FillTriangle(vecVerts[0], vecVerts[n - 1], vecVerts[n], t);
+			}
+			else if (decal.structure == olc::DecalStructure::STRIP)
+			{
+				for (uint32_t n = 2; n < decal.points; n++)
+					FillTriangle(vecVerts[n - 2], vecVerts[n - 1], vecVerts[n], t);
+			}
+			else
+			{
+				for (uint32_t n = 2; n < decal.points; n += 3)
+					FillTriangle(vecVerts[n - 2], vecVerts[n - 1], vecVerts[n], t);
+			}
+			bDepthTest = false;
+		}
+
+		virtual uint32_t CreateTexture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true)
+		{
+			// Sized by the first UpdateTexture()
+			UNUSED(width);
+			UNUSED(height);
+			auto t = std::make_unique<Texture>();
+			t->bFiltered = filtered;
+			t->bClamp = clamp;
+			// Ids are unique across renderers, see DeleteTexture()
+			static std::atomic<uint32_t> nNextTexture{ 1 };
+			uint32_t id = nNextTexture++;
+			mapTextures[id] = std::move(t);
+			return id;
+		}
+
+		virtual void UpdateTexture(uint32_t id, olc::Sprite* spr)
+		{
+			auto it = mapTextures.find(id);
+			if (it == mapTextures.end()) return;
+			it->second->sprite.SetSize(spr->width, spr->height);
+			it->second->sprite.pColData = spr->pColData;
+		}
+
+		virtual bool UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size)
+		{
+			auto it = mapTextures.find(id);
+			if (it == mapTextures.end()) return true;
+			olc::Sprite& dst = it->second->sprite;
+			if (dst.width != spr->width || dst.height != spr->height)
+				return false;
+			for (int32_t y = pos.y; y < pos.y + size.y; y++)
+				std::memcpy(&dst.pColData[size_t(y) * dst.width + pos.x], &spr->pColData[size_t(y) * spr->width + pos.x], size_t(size.x) * sizeof(olc::Pixel));
+			return true;
+		}
+
+		virtual void ReadTexture(uint32_t id, olc::Sprite* spr)
+		{
+			const Texture* t = FindTexture(id);
+			if (t != nullptr && t->sprite.width == spr->width && t->sprite.height == spr->height)
+				spr->pColData = t->sprite.pColData;
+		}
+
+		// Textures made through another engine's renderer can arrive here
+		// when an app constructs several engines, so unknown ids are ignored
+		virtual uint32_t DeleteTexture(const uint32_t id)
+		{
+			mapTextures.erase(id);
+			return id;
+		}
+
+		virtual void ApplyTexture(uint32_t id)
+		{ nAppliedTexture = id; }
+
+		// pos is from the bottom left, as glViewport() takes it
+		virtual void UpdateViewport(const olc::vi2d& pos, const olc::vi2d& size)
+		{
+			SizeFrame();
+			vViewPos = { pos.x, sprFrame.height - pos.y - size.y };
+			vViewSize = size;
+		}
+
+		virtual void ClearBuffer(olc::Pixel p, bool bDepth)
+		{
+			SizeFrame();
+			std::fill(sprFrame.pColData.begin(), sprFrame.pColData.end(), olc::Pixel(p.r, p.g, p.b));
+			if (bDepth) std::fill(vecDepth.begin(), vecDepth.end(), 1.0f);
+		}
+
+		virtual const olc::Sprite* GetFrameBuffer() const
+		{ return &sprFrame; }
 	};
 #endif
 #if defined(OLC_PLATFORM_HEADLESS)
@@ -5036,6 +6944,15 @@ namespace olc
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
 		}
 
+		bool UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(id);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->width);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + size_t(pos.y) * spr->width + pos.x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+			return true;
+		}
+
 		void ReadTexture(uint32_t id, olc::Sprite* spr) override
 		{
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
@@ -5204,6 +7121,9 @@ namespace olc
 		locGenVertexArrays_t* locGenVertexArrays = nullptr;
 		locSwapInterval_t* locSwapInterval = nullptr;
 		locGetShaderInfoLog_t* locGetShaderInfoLog = nullptr;
+#if defined(OLC_PLATFORM_EMSCRIPTEN)
+		bool bUnpackSubimage = false;	// GL_UNPACK_ROW_LENGTH_EXT can be used
+#endif
 
 		uint32_t m_nFS = 0;
 		uint32_t m_nVS = 0;
@@ -5218,7 +7138,9 @@ namespace olc
 			olc::Pixel col;
 		};
 
-		locVertex pVertexMem[OLC_MAX_VERTS];
+		// Grows to fit the largest decal seen, so batched polygon decals
+		// are not limited to OLC_MAX_VERTS vertices
+		std::vector<locVertex> pVertexMem = std::vector<locVertex>(OLC_MAX_VERTS);
 
 		olc::Renderable rendBlankQuad;
 
@@ -5311,6 +7233,8 @@ namespace olc
 			//eglSwapInterval is currently a NOP, plement anyways in case it becomes supported
 			locSwapInterval = &eglSwapInterval;
 			locSwapInterval(olc_Display, bVSYNC ? 1 : 0);
+			const char* sExtensions = (const char*)glGetString(GL_EXTENSIONS);
+			bUnpackSubimage = sExtensions != nullptr && strstr(sExtensions, "GL_EXT_unpack_subimage") != nullptr;
 #endif
 
 #if defined(OLC_PLATFORM_GLUT)
@@ -5511,10 +7435,13 @@ namespace olc
 
 			locBindBuffer(0x8892, m_vbQuad);
 
+			if (pVertexMem.size() < decal.points)
+				pVertexMem.resize(decal.points);
+
 			for (uint32_t i = 0; i < decal.points; i++)
 				pVertexMem[i] = { { decal.pos[i].x, decal.pos[i].y, decal.w[i] }, { decal.uv[i].x, decal.uv[i].y }, decal.tint[i] };
 
-			locBufferData(0x8892, sizeof(locVertex) * decal.points, pVertexMem, 0x88E0);
+			locBufferData(0x8892, sizeof(locVertex) * decal.points, pVertexMem.data(), 0x88E0);
 
 			if (nDecalMode == DecalMode::WIREFRAME)
 				glDrawArrays(GL_LINE_LOOP, 0, decal.points);
@@ -5576,6 +7503,30 @@ namespace olc
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
 		}
 
+		bool UpdateTextureRegion(uint32_t id, olc::Sprite* spr, const olc::vi2d& pos, const olc::vi2d& size) override
+		{
+			UNUSED(id);
+#if defined(OLC_PLATFORM_EMSCRIPTEN)
+	#if defined(GL_UNPACK_ROW_LENGTH_EXT)
+			if (bUnpackSubimage)
+			{
+				glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, spr->width);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + size_t(pos.y) * spr->width + pos.x);
+				glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+				return true;
+			}
+	#endif
+			// GLES2 has no row length without EXT_unpack_subimage, so whole
+			// rows are sent, which are contiguous in the sprite
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, pos.y, spr->width, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + size_t(pos.y) * spr->width);
+#else
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->width);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, pos.x, pos.y, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData() + size_t(pos.y) * spr->width + pos.x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+			return true;
+		}
+
 		void ReadTexture(uint32_t id, olc::Sprite* spr) override
 		{
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->GetData());
@@ -1,163 +1,39 @@
 #include <cstdlib>
 #include <cstdio>
-#include <cstring>
 #include <vector>
+#include <string>
+#include <thread>
+#include <map>
+#include <filesystem>
 
-typedef unsigned char byte;
+#include "../MidiWriter.h"
+#include "../MidiModel.h"
 
-class MIDIvec : public std::vector<byte>
+/* Overwrite a 64-row line with a phrase drawn from the melody model.
+ * Pitches are relative to the line's own root and are folded back by
+ * octaves whenever the walk leaves [low, high].
+ */
+template <int ORDER>
+void SampleLine(typename MidiMelodyModel<ORDER>::Sampler &sampler, char (&line)[64], char x, int start, int low, int high)
 {
-public:
-    template <typename... Args>
-    void AddBytes(byte data, Args... args)
-    {
-        push_back(data);
-        AddBytes(args...);
-    }
-    template <typename... Args>
-    void AddBytes(const char *s, Args... args)
-    {
-        insert(end(), s, s + std::strlen(s));
-        AddBytes(args...);
-    }
-    void AddBytes() {}
-};
-
-class MIDItrack : public MIDIvec
-{
-protected:
-    unsigned delay, running_status;
-
-public:
-    MIDItrack()
-        : MIDIvec(), delay(0), running_status(0)
-    {
-    }
-
-    void AddDelay(unsigned amount) { delay += amount; }
-
-    void AddVarLen(unsigned t)
-    {
-        if (t >> 21)
-            AddBytes(0x80 | ((t >> 21) & 0x7F));
-        if (t >> 14)
-            AddBytes(0x80 | ((t >> 14) & 0x7F));
-        if (t >> 7)
-            AddBytes(0x80 | ((t >> 7) & 0x7F));
-        AddBytes(((t >> 0) & 0x7F));
-    }
-
-    void Flush()
-    {
-        AddVarLen(delay);
-        delay = 0;
-    }
-
-    template <typename... Args>
-    void AddEvent(byte data, Args... args)
-    {
-        Flush();
-        if (data != running_status)
-            AddBytes(running_status = data);
-        AddBytes(args...);
-    }
-    void AddEvent() {}
-
-    template <typename... Args>
-    void AddMetaEvent(byte metatype, byte nbytes, Args... args)
-    {
-        Flush();
-        AddBytes(0xFF, metatype, nbytes, args...);
-    }
+    for (int i = 0; i < 64; ++i)
+        line[i] = x;
 
-    // Key-related parameters: channel number, note number, pressure
-    void KeyOn(int ch, int n, int p)
+    int note = start;
+    for (int row = 0; row < 64;)
     {
-        if (n >= 0)
-            AddEvent(0x90 | ch, n, p);
+        line[row] = note;
+        MidiToken token = sampler.Next();
+        row += token.nSteps;
+        note += token.nInterval;
+        while (note > high)
+            note -= 12;
+        while (note < low)
+            note += 12;
     }
-    void KeyOff(int ch, int n, int p)
-    {
-        if (n >= 0)
-            AddEvent(0x80 | ch, n, p);
-    }
-    void KeyTouch(int ch, int n, int p)
-    {
-        if (n >= 0)
-            AddEvent(0xA0 | ch, n, p);
-    }
-    // Events with other types of parameters:
-    void Control(int ch, int c, int v) { AddEvent(0xB0 | ch, c, v); }
-    void Patch(int ch, int patchno) { AddEvent(0xC0 | ch, patchno); }
-    void Wheel(int ch, unsigned value) { AddEvent(0xE0 | ch, value & 0x7F, (value >> 7) & 0x7F); }
-
-    void AddText(int texttype, const char *text)
-    {
-        AddMetaEvent(texttype, std::strlen(text), text);
-    }
-};
-
-class MIDIfile : public MIDIvec
-{
-protected:
-    std::vector<MIDItrack> tracks;
-    unsigned deltaticks, tempo;
-
-public:
-    MIDIfile()
-        : MIDIvec(), tracks(), deltaticks(1000), tempo(1000000)
-    {
-    }
-    void AddLoopStart() { (*this)[0].AddText(6, "loopStart"); }
-    void AddLoopEnd() { (*this)[0].AddText(6, "loopEnd"); }
-
-    MIDItrack &operator[](unsigned trackno)
-    {
-        if (trackno >= tracks.size())
-        {
-            tracks.reserve(16);
-            tracks.resize(trackno + 1);
-        }
-
-        MIDItrack &result = tracks[trackno];
-        if (result.empty())
-        {
-            //      time signature: 4/4
-            //      ticks/metro:    32
-            //      32nd per 1/4:   8
-            result.AddMetaEvent(0x58, 4, 4, 4, 32, 8);
-            // Meta 0x51 (tempo):
-            result.AddMetaEvent(0x51, 3, tempo >> 16, tempo >> 8, tempo);
-        }
-        return result;
-    }
-
-    void Finish()
-    {
-        clear();
-        AddBytes(
-            // MIDI signature (MThd and number 6)
-            "MThd", 0, 0, 0, 6,
-            // Format number (1: multiple tracks, synchronous)
-            0, 1,
-            tracks.size() >> 8, tracks.size(),
-            deltaticks >> 8, deltaticks);
-        for (unsigned a = 0; a < tracks.size(); ++a)
-        {
-            // Add meta 0x2F to the track, indicating the track end:
-            tracks[a].AddMetaEvent(0x2F, 0);
-            // Add the track into the MIDI file:
-            AddBytes("MTrk",
-                     tracks[a].size() >> 24,
-                     tracks[a].size() >> 16,
-                     tracks[a].size() >> 8,
-                     tracks[a].size() >> 0);
-            insert(end(), tracks[a].begin(), tracks[a].end());
-        }
-    }
-};
+}
 
-int main()
+int main(int argc, char *argv[])
 {
     static int chords[][16] = {
         // tonics
@@ -236,8 +112,27 @@ int main()
             chordline[i] = (m + (n * 10));
         }
     }
-    MIDIfile file;
-    file.AddLoopStart();
+    // Learn melodic movement from whatever MIDI files are in the corpus
+    // folder and use it in place of the fixed bass and flute lines.
+    std::vector<std::string> corpus;
+    std::error_code ec;
+    for (auto &entry : std::filesystem::directory_iterator(argc > 1 ? argv[1] : "../audio and or visual", ec))
+        if (entry.path().extension() == ".mid")
+            corpus.push_back(entry.path().string());
+
+    MidiMelodyModel<3> model;
+    if (!corpus.empty() && model.Train(corpus) > 0 && !model.Empty())
+    {
+        MidiMelodyModel<3>::Sampler sampler(model, std::rand());
+        SampleLine<3>(sampler, bassline, x, 0, -5, 8);
+        sampler.Reset();
+        SampleLine<3>(sampler, fluteline, x, 12, 0, 19);
+    }
+
+    static char drumline[64] = {
+        36, x, 42, x, 38, x, 42, x, 36, x, 36, x, 38, x, 42, x, 36, x, 42, x, 38, x, 42, x, 36, x, 36, x, 38, x, 42, 42,
+        36, x, 42, x, 38, x, 42, x, 36, x, 36, x, 38, x, 42, x, 36, x, 42, x, 38, x, 38, x, 36, x, 38, 38, 38, x, 49, x};
+
     static char instruments[15] = {2, 3, 8, 12, 18, 27, 37, 52, 55, 58, 64, 67, 79, 80, 106};
     /* Choose instruments ("patches") for each channel: */
     static char patches[16] = {};
@@ -246,58 +141,159 @@ int main()
         int index = std::rand() % 15;
         patches[i] = instruments[index];
     }
-    for (unsigned c = 0; c < 16; ++c)
-        if (c != 10) // Patch any other channel but not the percussion channel.
-            file[0].Patch(c, patches[c]);
 
-    int keys_on[16] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
-    for (unsigned loops = 0; loops < 2; ++loops)
+    /* Each role is written to its own track (format 1); track 0 only carries
+     * the tempo, time signature and section/loop markers.
+     */
+    struct Role
+    {
+        const char *name;
+        unsigned first, last; // Channel range
+    };
+    static const Role roles[] = {
+        {"Chord", 0, 2},
+        {"Aux Choir", 3, 4},
+        {"Aux Strings", 6, 7},
+        {"Bass", 14, 14},
+        {"Flute", 15, 15},
+        {"Percussion", 9, 9}};
+    const unsigned nroles = sizeof(roles) / sizeof(roles[0]);
+
+    /* Songs are built from sections. Each section plays a window of the lines
+     * above on a subset of the channels; a variation transposes the section.
+     */
+    enum SectionType { Intro, Verse, Chorus, Bridge };
+    struct Section
+    {
+        const char *name;
+        unsigned offset, rows; // Window of the 64-row lines
+        unsigned channels;     // Bit mask of the channels that play
+    };
+    static const Section sections[] = {
+        {"Intro", 0, 32, 1 << 3 | 1 << 4 | 1 << 6 | 1 << 7},
+        {"Verse", 0, 64, 1 << 0 | 1 << 1 | 1 << 2 | 1 << 6 | 1 << 7 | 1 << 9 | 1 << 14},
+        {"Chorus", 0, 64, 0xFFFF},
+        {"Bridge", 32, 32, 1 << 0 | 1 << 1 | 1 << 2 | 1 << 3 | 1 << 4 | 1 << 14 | 1 << 15}};
+    struct Part
     {
-        for (unsigned row = 0; row < 128; ++row)
+        SectionType type;
+        unsigned variation;
+    };
+
+    /* Constrained-random form: always opens with the intro, then two or three
+     * verse/chorus pairs, a bridge that can only lead into a chorus, and a
+     * final chorus repeated with a key change.
+     */
+    std::vector<Part> form;
+    form.push_back({Intro, 0});
+    for (int i = 2 + std::rand() % 2; i > 0; --i)
+    {
+        form.push_back({Verse, 0});
+        form.push_back({Chorus, 0});
+    }
+    if (std::rand() % 2)
+        form.push_back({Bridge, 0});
+    form.push_back({Chorus, 0});
+    form.push_back({Chorus, 1});
+
+    const unsigned rowticks = 160;
+
+    MIDIfile file;
+    for (auto &part : form)
+    {
+        if (&part == &form[1])
+            file.AddLoopStart();
+        file[0].AddText(6, sections[part.type].name);
+        file[0].AddDelay(sections[part.type].rows * rowticks);
+    }
+    file.AddLoopEnd();
+    // Create every track up front so the workers never resize the list
+    for (unsigned r = 0; r < nroles; ++r)
+        file[r + 1].AddText(3, roles[r].name);
+
+    // Every channel holds its note until the next one it plays, or the end
+    // of the section; the flute is also cut every 31 rows. Each row is 160 ticks.
+    auto ScheduleChannel = [&](MIDIscheduler &scheduler, unsigned c, const Section &section, unsigned variation)
+    {
+        if (!(section.channels & (1 << c)))
+            return;
+        int key_on = -1, vol_on = 0;
+        unsigned start = 0;
+        for (unsigned t = 0; t < section.rows; ++t)
         {
-            for (unsigned c = 0; c < 16; ++c)
+            unsigned row = (section.offset + t) % 64;
+            int note = x, add = 0, vol = 127;
+            if (c < 3) // Piano chord
             {
-                int note = x, add = 0, vol = 127;
-                if (c < 3) // Piano chord
-                {
-                    int chord = chordline[row % 64];
-                    if (chord != x)
-                        note = chords[chord][c % 3], add = 12 * 5, vol = 0x4B;
-                }
-                else if (c >= 3 && c < 5) // Aux chord (choir)
-                {
-                    int chord = chordline2[row % 64];
-                    if (chord != x)
-                        note = chords[chord][c % 3], add = 12 * 4, vol = 0x50;
-                }
-                else if (c >= 6 && c < 8) // Aux chord (strings)
+                int chord = chordline[row];
+                if (chord != x)
+                    note = chords[chord][c % 3], add = 12 * 5, vol = 0x4B;
+            }
+            else if (c >= 3 && c < 5) // Aux chord (choir)
+            {
+                int chord = chordline2[row];
+                if (chord != x)
+                    note = chords[chord][c % 3], add = 12 * 4, vol = 0x50;
+            }
+            else if (c >= 6 && c < 8) // Aux chord (strings)
+            {
+                int chord = chordline2[row];
+                if (chord != x)
+                    note = chords[chord][c % 3], add = 12 * 5, vol = 0x45;
+            }
+            else if (c == 9) // Percussion
+                note = drumline[row], vol = 0x64;
+            else if (c == 14) // Bass
+                note = bassline[row], add = 12 * 3, vol = 0x6F;
+            else if (c == 15) // Flute
+                note = fluteline[row], add = 12 * 5, vol = 0x6F;
+            if (note == x && (c < 15 || t % 31))
+                continue;
+            scheduler.Note(start * rowticks, (t - start) * rowticks, c, key_on, vol_on);
+            key_on = -1;
+            if (note == x)
+                continue;
+            if (c != 9)
+                add += 2 * variation;
+            key_on = note + add, vol_on = vol, start = t;
+        }
+        scheduler.Note(start * rowticks, (section.rows - start) * rowticks, c, key_on, vol_on);
+    };
+
+    // Encode the role tracks concurrently, one thread each. Every distinct
+    // section is encoded once per role; repeats append the cached bytes.
+    std::vector<std::thread> workers;
+    for (unsigned r = 0; r < nroles; ++r)
+        workers.emplace_back([&, r]()
+        {
+            MIDItrack &track = file[r + 1];
+            for (unsigned c = roles[r].first; c <= roles[r].last; ++c)
+                if (c != 9) // Patch any other channel but not the percussion channel.
+                    track.Patch(c, patches[c]);
+
+            std::map<std::pair<int, unsigned>, MIDItrack> cache;
+            for (auto &part : form)
+            {
+                const Section &section = sections[part.type];
+                auto found = cache.find({part.type, part.variation});
+                if (found == cache.end())
                 {
-                    int chord = chordline2[row % 64];
-                    if (chord != x)
-                        note = chords[chord][c % 3], add = 12 * 5, vol = 0x45;
+                    MIDIscheduler scheduler;
+                    for (unsigned c = roles[r].first; c <= roles[r].last; ++c)
+                        ScheduleChannel(scheduler, c, section, part.variation);
+                    found = cache.emplace(std::make_pair(int(part.type), part.variation), MIDItrack()).first;
+                    scheduler.Drain(found->second, section.rows * rowticks);
                 }
-                else if (c == 14) // Bass
-                    note = bassline[row % 64], add = 12 * 3, vol = 0x6F;
-                else if (c == 15 && row >= 64) // Flute
-                    note = fluteline[row % 64], add = 12 * 5, vol = 0x6F;
-                if (note == x && (c < 15 || row % 31))
-                    continue;
-                file[0].KeyOff(c, keys_on[c], 0x20);
-                keys_on[c] = -1;
-                if (note == x)
-                    continue;
-                file[0].KeyOn(c, keys_on[c] = note + add, vol);
+                track.AddRun(found->second);
             }
-            file[0].AddDelay(160);
-        }
-        if (loops == 0)
-            file.AddLoopEnd();
-    }
+        });
+    for (auto &worker : workers)
+        worker.join();
 
     file.Finish();
 
     FILE *fp = std::fopen("test.mid", "wb");
-    std::fwrite(&file.at(0), 1, file.size(), fp);
+    file.Write(fp);
     std::fclose(fp);
 
     return 0;
@@ -0,0 +1,777 @@
+/* Benchmarks for the engine's software drawing paths on the viewer's typical
+ * workload, built headless so no window or GPU is needed.
+ *
+ * Each case draws the same frame through the engine and through a reference
+ * that plots every pixel with Draw(), as the engine used to, then checks the
+ * two frames are bit-identical and reports how long each took. The span
+ * blitters are also checked pixel for pixel against Draw() on random data, so
+ * their SIMD paths (or the scalar ones, with -DOLC_NO_SIMD) are covered too.
+ *
+ * Sprite blits are checked against the old per-pixel DrawPartialSprite, on
+ * random draws and on a frame of roll tiles, thumbnails, icons and panels.
+ * Layer dirty rectangles are checked to cover every pixel each kind of
+ * drawing changes, directly and through the command buffer.
+ * Batch sampling is checked against one Sample() or SampleBL() per texel in
+ * every sample mode, and timed on a zoomed spectrogram.
+ * Text is checked against drawing it in CUSTOM pixel mode, which still goes
+ * pixel by pixel, with a blend function that matches MASK or ALPHA.
+ *
+ * A 4K piano roll of rectangles, lines, text and sprites is drawn through
+ * the command buffer on 1, 2, 4 and 8 threads, and checked against drawing
+ * it directly.
+ *
+ * Last, the headless renderer's composited frames are checked against
+ * blending the layers and decals by hand, and a frame of roll notes as
+ * decals is timed. An app that only redraws on change is then left idle and
+ * woken by a key press, which must not see more than one poll period as its
+ * elapsed time.
+ *
+ * usage: pgebench [frames]
+ */
+#define OLC_PGE_HEADLESS
+#define OLC_PGE_APPLICATION
+
+#include "olcPixelGameEngine.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+class Bench : public olc::PixelGameEngine
+{
+public:
+    // FillRect as it was before span fills: clipped, then one virtual
+    // Draw() per pixel in column-major order
+    void ReferenceFillRect(int32_t x, int32_t y, int32_t w, int32_t h, olc::Pixel p)
+    {
+        int32_t x2 = std::min(x + w, GetDrawTargetWidth()), y2 = std::min(y + h, GetDrawTargetHeight());
+        x = std::max(x, 0);
+        y = std::max(y, 0);
+        for (int32_t i = x; i < x2; ++i)
+            for (int32_t j = y; j < y2; ++j)
+                Draw(i, j, p);
+    }
+
+    // DrawPartialSprite as it was before row blits: GetPixel() and Draw() for
+    // every pixel, column by column
+    void ReferenceDrawPartialSprite(int32_t x, int32_t y, olc::Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip)
+    {
+        int32_t fxs = 0, fxm = 1, fx = 0;
+        int32_t fys = 0, fym = 1, fy = 0;
+        if (flip & olc::Sprite::Flip::HORIZ) { fxs = w - 1; fxm = -1; }
+        if (flip & olc::Sprite::Flip::VERT) { fys = h - 1; fym = -1; }
+
+        fx = fxs;
+        for (int32_t i = 0; i < w; i++, fx += fxm)
+        {
+            fy = fys;
+            for (int32_t j = 0; j < h; j++, fy += fym)
+            {
+                if (scale > 1)
+                {
+                    for (uint32_t is = 0; is < scale; is++)
+                        for (uint32_t js = 0; js < scale; js++)
+                            Draw(x + (i * scale) + is, y + (j * scale) + js, sprite->GetPixel(fx + ox, fy + oy));
+                }
+                else
+                    Draw(x + i, y + j, sprite->GetPixel(fx + ox, fy + oy));
+            }
+        }
+    }
+
+    void ReferenceClear(olc::Pixel p)
+    {
+        for (int32_t y = 0; y < GetDrawTargetHeight(); ++y)
+            for (int32_t x = 0; x < GetDrawTargetWidth(); ++x)
+                GetDrawTarget()->SetPixel(x, y, p);
+    }
+};
+
+struct Rect
+{
+    int32_t x, y, w, h;
+    olc::Pixel p;
+};
+
+// A frame of the piano roll: track backgrounds, then thousands of short
+// notes two pixels high, some hanging off the edges
+static std::vector<Rect> RollFrame(int32_t width, int32_t height, uint8_t alpha)
+{
+    uint32_t seed = 0x2545F491u;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    std::vector<Rect> rects;
+    for (int32_t y = 0; y < height; y += 124)
+        rects.push_back({ 0, y, width, 120, olc::Pixel(64, 64, 64, alpha) });
+    for (int n = 0; n < 6000; ++n)
+    {
+        int32_t x = int32_t(Random() % (width + 100)) - 50;
+        int32_t y = int32_t(Random() % (height / 2)) * 2;
+        int32_t w = 1 + int32_t(Random() % 60);
+        rects.push_back({ x, y, w, 2, olc::Pixel(Random() & 0xFF, Random() & 0xFF, Random() & 0xFF, alpha) });
+    }
+    return rects;
+}
+
+// A 4K roll: shaded tracks, translucent velocity-coloured notes, bar lines,
+// a label and an icon per track, and a selection outline
+static void RollScene(Bench &bench, olc::Sprite *icon)
+{
+    uint32_t seed = 0x68E31DA4u;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    const int32_t width = bench.GetDrawTargetWidth(), height = bench.GetDrawTargetHeight();
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+    bench.Clear(olc::VERY_DARK_GREY);
+    for (int32_t y = 0; y < height; y += 136)
+        bench.FillRect(0, y, width, 128, olc::Pixel(32, 32, 48));
+    for (int32_t x = 0; x < width; x += 120)
+        bench.DrawLine(x, 0, x, height - 1, olc::DARK_GREY, 0xF0F0F0F0);
+
+    bench.SetPixelMode(olc::Pixel::ALPHA);
+    for (int n = 0; n < 20000; ++n)
+    {
+        int32_t x = int32_t(Random() % (width + 100)) - 50;
+        int32_t y = int32_t(Random() % (height / 2)) * 2;
+        uint8_t velocity = uint8_t(Random() % 128);
+        bench.FillRect(x, y, 1 + int32_t(Random() % 120), 2, olc::Pixel(velocity * 2, 255 - velocity, 128, 200));
+    }
+
+    bench.SetPixelMode(olc::Pixel::MASK);
+    for (int32_t y = 0; y < height; y += 136)
+    {
+        bench.DrawSprite(4, y + 4, icon, 2);
+        bench.DrawString(44, y + 8, "Track " + std::to_string(y / 136), olc::WHITE, 2);
+        bench.DrawStringProp(44, y + 28, "Piano, channel 1", olc::Pixel(255, 255, 255, 160));
+    }
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+    bench.DrawRect(width / 3, height / 4, width / 3, height / 2, olc::YELLOW);
+}
+
+// Random partial sprite draws on a small target against the reference, with
+// every scale, flip and mode, clipped at all edges and sometimes reaching
+// outside the source sprite
+static bool CheckSprites(Bench &bench)
+{
+    uint32_t seed = 0x85EBCA6Bu;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    olc::Sprite source(40, 24), fast(64, 48), slow(64, 48);
+    for (auto &p : source.pColData)
+    {
+        p.n = Random();
+        if (Random() % 3 == 0) p.a = 255;
+    }
+    for (size_t i = 0; i < fast.pColData.size(); ++i)
+        fast.pColData[i].n = slow.pColData[i].n = Random();
+
+    const olc::Pixel::Mode modes[] = { olc::Pixel::NORMAL, olc::Pixel::MASK, olc::Pixel::ALPHA };
+    for (int n = 0; n < 20000; ++n)
+    {
+        int32_t x = int32_t(Random() % 100) - 30, y = int32_t(Random() % 80) - 20;
+        int32_t ox = int32_t(Random() % 44) - 2, oy = int32_t(Random() % 28) - 2;
+        int32_t w = int32_t(Random() % 42), h = int32_t(Random() % 26);
+        uint32_t scale = Random() % 6;
+        uint8_t flip = uint8_t(Random() % 4);
+        bench.SetPixelMode(modes[Random() % 3]);
+        bench.SetPixelBlend((Random() % 256) / 255.0f);
+
+        bench.SetDrawTarget(&fast);
+        bench.DrawPartialSprite(x, y, &source, ox, oy, w, h, scale, flip);
+        bench.SetDrawTarget(&slow);
+        bench.ReferenceDrawPartialSprite(x, y, &source, ox, oy, w, h, scale, flip);
+        if (fast.pColData != slow.pColData)
+            return false;
+    }
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+    bench.SetPixelBlend(1.0f);
+    return true;
+}
+
+// Every pixel a random mix of drawing changes on layer 0 must lie inside the
+// layer's dirty rectangles
+static bool CheckDirtyRects(Bench &bench, olc::Sprite *icon)
+{
+    uint32_t seed = 0xC2B2AE35u;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    olc::LayerDesc &layer = bench.GetLayers()[0];
+    olc::Sprite *target = layer.pDrawTarget.Sprite();
+    for (int round = 0; round < 400; ++round)
+    {
+        bench.SetDrawTarget(nullptr);
+        bench.EnableCommandBuffer(round % 2 == 1, 2);
+        std::vector<olc::Pixel> before = target->pColData;
+        layer.dirty.vecRects.clear();
+        for (int n = 0; n < 1 + int(Random() % 12); ++n)
+        {
+            int32_t x = int32_t(Random() % 1400) - 60, y = int32_t(Random() % 1080) - 60;
+            int32_t x2 = int32_t(Random() % 1400) - 60, y2 = int32_t(Random() % 1080) - 60;
+            olc::Pixel p(Random() | 0x01010101);
+            bench.SetPixelMode(Random() % 2 ? olc::Pixel::NORMAL : olc::Pixel::ALPHA);
+            switch (Random() % 9)
+            {
+            case 0: bench.Draw(x, y, p); break;
+            case 1: bench.DrawLine(x, y, x2, y2, p); break;
+            case 2: bench.FillRect(x, y, x2 % 200, y2 % 100, p); break;
+            case 3: bench.FillCircle(x, y, int32_t(Random() % 40), p); break;
+            case 4: bench.DrawCircle(x, y, int32_t(Random() % 40), p); break;
+            case 5: bench.FillTriangle(x, y, x2, y2, x + 30, y2 - 50, p); break;
+            case 6: bench.DrawSprite(x, y, icon, 1 + Random() % 3, uint8_t(Random() % 4)); break;
+            case 7: bench.DrawString(x, y, "dirty\nrect", p, 1 + Random() % 2); break;
+            case 8: bench.DrawStringProp(x, y, "Track 12", p); break;
+            }
+        }
+        bench.EnableCommandBuffer(false);
+        for (int32_t y = 0; y < target->height; ++y)
+            for (int32_t x = 0; x < target->width; ++x)
+            {
+                if (target->pColData[size_t(y) * target->width + x] == before[size_t(y) * target->width + x])
+                    continue;
+                bool covered = false;
+                for (auto &r : layer.dirty.vecRects)
+                    covered |= x >= r.first.x && x < r.second.x && y >= r.first.y && y < r.second.y;
+                if (!covered)
+                    return false;
+            }
+    }
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+    return true;
+}
+
+// Cached roll tiles over the whole frame, scaled and flipped thumbnails,
+// masked icons and a translucent panel
+struct SpriteDraw
+{
+    olc::Sprite *sprite;
+    int32_t x, y;
+    uint32_t scale;
+    uint8_t flip;
+    olc::Pixel::Mode mode;
+};
+
+static std::vector<SpriteDraw> SpriteFrame(int32_t width, int32_t height, olc::Sprite *tile, olc::Sprite *thumb, olc::Sprite *icon, olc::Sprite *panel)
+{
+    std::vector<SpriteDraw> draws;
+    for (int32_t y = -40; y < height; y += tile->height)
+        for (int32_t x = -100; x < width; x += tile->width)
+            draws.push_back({ tile, x, y, 1, olc::Sprite::NONE, olc::Pixel::NORMAL });
+    for (int32_t i = 0; i < 8; ++i)
+        draws.push_back({ thumb, 20 + (i % 4) * 300, 40 + (i / 4) * 200, 2 + uint32_t(i % 2), uint8_t(i % 4), olc::Pixel::NORMAL });
+    for (int32_t i = 0; i < 60; ++i)
+        draws.push_back({ icon, 8 + (i % 10) * 120, 500 + (i / 10) * 64, 1 + uint32_t(i % 3), olc::Sprite::NONE, olc::Pixel::MASK });
+    draws.push_back({ panel, width - 500, height - 300, 1, olc::Sprite::NONE, olc::Pixel::ALPHA });
+    return draws;
+}
+
+// A label per track and a readout per bar, some hanging off the edges
+static void LabelFrame(Bench &bench, bool reference)
+{
+    auto Label = [&](int32_t x, int32_t y, const std::string &text, olc::Pixel col, uint32_t scale, bool prop)
+    {
+        if (reference)
+            bench.SetPixelMode([col](int, int, const olc::Pixel &s, const olc::Pixel &d)
+            {
+                return col.a == 255 ? s : olc::span::BlendPixel(s, d, 255);
+            });
+        else
+            bench.SetPixelMode(olc::Pixel::NORMAL);
+        if (prop)
+            bench.DrawStringProp(x, y, text, col, scale);
+        else
+            bench.DrawString(x, y, text, col, scale);
+    };
+
+    const int32_t width = bench.GetDrawTargetWidth(), height = bench.GetDrawTargetHeight();
+    for (int32_t y = -4; y < height; y += 40)
+    {
+        Label(-6, y, "Track " + std::to_string(y / 40) + ": Acoustic Grand Piano", olc::WHITE, 1, false);
+        Label(240, y, "Strings\tch 2", olc::Pixel(255, 200, 120, 160), 2, true);
+        Label(width - 100, y + 20, "vel 100\nkey C#4", olc::Pixel(120, 200, 255, 200), 1, false);
+        for (int32_t x = 480; x < width; x += 120)
+            Label(x, y + 10, std::to_string(x / 120 + 1) + ".1", olc::GREY, 1, true);
+    }
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+}
+
+template <typename F>
+static double Time(int frames, F &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i)
+        fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+// Largest difference in r, g or b
+static int ChannelDiff(olc::Pixel a, olc::Pixel b)
+{
+    return std::max({ std::abs(a.r - b.r), std::abs(a.g - b.g), std::abs(a.b - b.b) });
+}
+
+// Batch sampling against single samples in each sample mode. Nearest must
+// match exactly; bilinear may round a step or two lower. Spans start and step
+// on multiples of 1/256 texel so their fixed point positions are exact.
+static bool CheckSampling()
+{
+    uint32_t seed = 0x85EBCA6Bu;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    olc::Sprite tex(64, 32);
+    for (auto &p : tex.pColData)
+        p.n = Random();
+
+    for (auto mode : { olc::Sprite::Mode::NORMAL, olc::Sprite::Mode::PERIODIC, olc::Sprite::Mode::CLAMP })
+    {
+        tex.SetSampleMode(mode);
+        std::vector<olc::vf2d> uv(4096);
+        for (auto &t : uv)
+            t = { (int32_t(Random() % 8192) - 2048) / 4096.0f, (int32_t(Random() % 8192) - 2048) / 4096.0f + 1e-4f * (Random() % 8) };
+        std::vector<olc::Pixel> out(uv.size()), out_bl(uv.size());
+        tex.Sample(uv.data(), out.data(), uv.size());
+        tex.SampleBL(uv.data(), out_bl.data(), uv.size());
+        for (size_t i = 0; i < uv.size(); ++i)
+            if (out[i] != tex.Sample(uv[i]) || ChannelDiff(out_bl[i], tex.SampleBL(uv[i])) > 2)
+                return false;
+
+        for (int run = 0; run < 200; ++run)
+        {
+            olc::vf2d start((int32_t(Random() % 8192) - 4096) / (64.0f * 256.0f), (int32_t(Random() % 8192) - 4096) / (32.0f * 256.0f));
+            olc::vf2d step((int32_t(Random() % 1024) - 512) / (64.0f * 256.0f), (int32_t(Random() % 256) - 128) / (32.0f * 256.0f));
+            size_t n = 1 + Random() % 300;
+            tex.SampleSpan(start, step, out.data(), n);
+            tex.SampleSpanBL(start, step, out_bl.data(), n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                olc::vf2d at = start + step * float(i);
+                if (out[i] != tex.Sample(at) || ChannelDiff(out_bl[i], tex.SampleBL(at)) > 2)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Every span blitter against one Draw() per pixel, over runs of every length
+// up to 40 so both the vector loops and their scalar tails are used
+static bool CheckBlitters(Bench &bench)
+{
+    uint32_t seed = 0x1B873593u;
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    for (uint32_t x = 0; x <= 255 * 255; ++x)
+        if (olc::span::Div255(x) != (x + 127) / 255)
+            return false;
+
+    olc::Sprite target(40, 1), source(40, 1), expected(40, 1);
+    for (auto mode : { olc::Pixel::NORMAL, olc::Pixel::MASK, olc::Pixel::ALPHA })
+        for (float blend : { 1.0f, 0.6f, 0.0f })
+            for (int32_t n = 0; n <= 40; ++n)
+                for (int k = 0; k < 64; ++k)
+                {
+                    for (int32_t i = 0; i < 40; ++i)
+                    {
+                        target.pColData[i].n = Random();
+                        source.pColData[i].n = Random();
+                        if (Random() % 4 == 0) source.pColData[i].a = 255;
+                    }
+                    olc::Pixel p(Random());
+                    bench.SetPixelMode(mode);
+                    bench.SetPixelBlend(blend);
+                    olc::SpanBlitter blit = bench.GetSpanBlitter();
+
+                    // Fill
+                    expected.pColData = target.pColData;
+                    bench.SetDrawTarget(&expected);
+                    for (int32_t i = 0; i < n; ++i)
+                        bench.Draw(i, 0, p);
+                    blit.Fill(target.pColData.data(), n, p, blit.nBlend);
+                    if (target.pColData != expected.pColData)
+                        return false;
+
+                    // Copy
+                    for (int32_t i = 0; i < n; ++i)
+                        bench.Draw(i, 0, source.pColData[i]);
+                    blit.Copy(target.pColData.data(), source.pColData.data(), n, blit.nBlend);
+                    if (target.pColData != expected.pColData)
+                        return false;
+                }
+    bench.SetPixelMode(olc::Pixel::NORMAL);
+    bench.SetPixelBlend(1.0f);
+    return true;
+}
+
+// Two layers and some decals, composited by the headless renderer at a pixel
+// size of 2. With frames set, instead submits that many frames of 2000 note
+// quads over a full layer and times them.
+class Scene : public olc::PixelGameEngine
+{
+public:
+    olc::Sprite icon{ 16, 16 };
+    std::unique_ptr<olc::Decal> decal;
+    olc::Sprite frame;
+    int frames = 0;
+    std::vector<olc::vf2d> quad_pos, quad_uv;
+    std::vector<olc::Pixel> quad_col;
+
+    bool OnUserCreate() override
+    {
+        for (int32_t i = 0; i < 16 * 16; ++i)
+            icon.pColData[i] = olc::Pixel(uint8_t(i * 16), uint8_t(i), 255 - uint8_t(i), i % 5 ? 255 : 90);
+        decal = std::make_unique<olc::Decal>(&icon);
+        EnableLayer(uint8_t(CreateLayer()), true);
+        SetFrameCallback([this](const olc::Sprite &f)
+        {
+            frame.SetSize(f.width, f.height);
+            frame.pColData = f.pColData;
+        });
+        return true;
+    }
+
+    bool OnUserUpdate(float) override
+    {
+        if (frames > 0)
+        {
+            quad_pos.clear();
+            quad_col.clear();
+            for (int i = 0; i < 2000; ++i)
+            {
+                float x = float(i * 37 % ScreenWidth()), y = float(i * 11 % ScreenHeight());
+                quad_pos.insert(quad_pos.end(), { { x, y }, { x, y + 4 }, { x + 30, y + 4 }, { x, y }, { x + 30, y + 4 }, { x + 30, y } });
+                quad_col.insert(quad_col.end(), 6, olc::Pixel(uint8_t(i), 200, 90));
+            }
+            quad_uv.assign(quad_pos.size(), { 0.0f, 0.0f });
+            SetDecalStructure(olc::DecalStructure::LIST);
+            DrawPolygonDecal(nullptr, quad_pos, quad_uv, quad_col);
+            return --frames > 0;
+        }
+
+        // Layer 0 is in front, with clear and translucent areas over layer 1
+        SetDrawTarget(uint8_t(1));
+        Clear(olc::DARK_BLUE);
+        FillRect(10, 10, 60, 40, olc::YELLOW);
+        SetDrawTarget(nullptr);
+        Clear(olc::BLANK);
+        FillRect(40, 20, 50, 50, olc::Pixel(255, 0, 0, 128));
+        FillRect(100, 70, 30, 30, olc::GREY);
+        DrawString(4, 100, "decal", olc::WHITE);
+        DrawDecal({ 20.0f, 60.0f }, decal.get());
+        DrawDecal({ 110.0f, 10.0f }, decal.get(), { 2.0f, 2.0f });
+        FillRectDecal({ 70.0f, 40.0f }, { 30.0f, 20.0f }, olc::Pixel(0, 255, 0, 100));
+        return false;
+    }
+
+    // What the frame should be at screen pixel x, y
+    olc::Pixel Expected(int32_t x, int32_t y)
+    {
+        auto Over = [](olc::Pixel s, olc::Pixel d)
+        {
+            uint32_t a = s.a, c = 255 - a;
+            auto Mix = [&](uint32_t sc, uint32_t dc) { uint32_t t = sc * a + dc * c + 128; return uint8_t((t + (t >> 8)) >> 8); };
+            return olc::Pixel(Mix(s.r, d.r), Mix(s.g, d.g), Mix(s.b, d.b));
+        };
+        olc::Pixel p = olc::BLACK;
+        p = Over(GetLayers()[1].pDrawTarget.Sprite()->GetPixel(x, y), p);
+        p = Over(GetLayers()[0].pDrawTarget.Sprite()->GetPixel(x, y), p);
+        if (x >= 20 && x < 36 && y >= 60 && y < 76)
+            p = Over(icon.GetPixel(x - 20, y - 60), p);
+        if (x >= 110 && x < 142 && y >= 10 && y < 42)
+            p = Over(icon.GetPixel((x - 110) / 2, (y - 10) / 2), p);
+        if (x >= 70 && x < 100 && y >= 40 && y < 60)
+            p = Over(olc::Pixel(0, 255, 0, 100), p);
+        return p;
+    }
+};
+
+// Redraws only on change and records the elapsed time of the frame a space
+// press wakes it for, then quits
+class Pacer : public olc::PixelGameEngine
+{
+public:
+    float pressed_elapsed = -1.0f;
+
+    bool OnUserCreate() override
+    {
+        SetRedrawOnChange(true, 10.0f);
+        return true;
+    }
+
+    bool OnUserUpdate(float fElapsedTime) override
+    {
+        if (!GetKey(olc::Key::SPACE).bPressed)
+            return true;
+        pressed_elapsed = fElapsedTime;
+        return false;
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 50;
+    const int32_t width = 1280, height = 960;
+
+    Bench bench;
+    bench.Construct(width, height, 1, 1);
+    olc::Sprite fast(width, height), slow(width, height);
+    bool ok = CheckBlitters(bench);
+    std::printf("span blitters %s Draw()\n", ok ? "match" : "DO NOT MATCH");
+
+    auto Case = [&](const char *name, olc::Pixel::Mode mode, uint8_t alpha, float blend)
+    {
+        std::vector<Rect> rects = RollFrame(width, height, alpha);
+        bench.SetPixelMode(mode);
+        bench.SetPixelBlend(blend);
+
+        bench.SetDrawTarget(&fast);
+        double fast_ms = Time(frames, [&]()
+        {
+            bench.Clear(olc::BLACK);
+            for (auto &r : rects)
+                bench.FillRect(r.x, r.y, r.w, r.h, r.p);
+        });
+
+        bench.SetDrawTarget(&slow);
+        double slow_ms = Time(frames, [&]()
+        {
+            bench.ReferenceClear(olc::BLACK);
+            for (auto &r : rects)
+                bench.ReferenceFillRect(r.x, r.y, r.w, r.h, r.p);
+        });
+
+        bool same = fast.pColData == slow.pColData;
+        ok = ok && same;
+        std::printf("%-8s %zu rects: %7.3f ms/frame, per pixel %7.3f ms/frame, %5.1fx, %s\n",
+            name, rects.size(), fast_ms, slow_ms, slow_ms / fast_ms, same ? "identical" : "MISMATCH");
+    };
+
+    Case("normal", olc::Pixel::NORMAL, 255, 1.0f);
+    Case("mask", olc::Pixel::MASK, 255, 1.0f);
+    Case("alpha", olc::Pixel::ALPHA, 160, 1.0f);
+    // A highlight over the whole roll: opaque colours, faded by the blend
+    Case("overlay", olc::Pixel::ALPHA, 255, 0.35f);
+    bench.SetPixelBlend(1.0f);
+
+    bench.olc_ConstructFontSheet();
+    {
+        bench.SetDrawTarget(&fast);
+        bench.Clear(olc::BLACK);
+        double fast_ms = Time(frames, [&]() { LabelFrame(bench, false); });
+        bench.SetDrawTarget(&slow);
+        bench.Clear(olc::BLACK);
+        double slow_ms = Time(frames, [&]() { LabelFrame(bench, true); });
+        bool same = fast.pColData == slow.pColData;
+        ok = ok && same;
+        std::printf("text     labels:      %7.3f ms/frame, per pixel %7.3f ms/frame, %5.1fx, %s\n",
+            fast_ms, slow_ms, slow_ms / fast_ms, same ? "identical" : "MISMATCH");
+    }
+
+    {
+        bool same = CheckSprites(bench);
+        ok = ok && same;
+        std::printf("sprite blits %s per-pixel drawing\n", same ? "match" : "DO NOT MATCH");
+
+        uint32_t seed = 0x27D4EB2Fu;
+        auto Fill = [&seed](olc::Sprite &sprite, bool holes, uint8_t alpha)
+        {
+            for (auto &p : sprite.pColData)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                p = olc::Pixel(seed >> 24, seed >> 16, seed >> 8, holes && (seed & 3) == 0 ? 0 : alpha);
+            }
+        };
+        olc::Sprite tile(256, 128), thumb(120, 60), icon(16, 16), panel(480, 280);
+        Fill(tile, false, 255);
+        Fill(thumb, false, 255);
+        Fill(icon, true, 255);
+        Fill(panel, false, 150);
+        std::vector<SpriteDraw> draws = SpriteFrame(width, height, &tile, &thumb, &icon, &panel);
+
+        bench.SetDrawTarget(&fast);
+        double fast_ms = Time(frames, [&]()
+        {
+            for (auto &d : draws)
+            {
+                bench.SetPixelMode(d.mode);
+                bench.DrawSprite(d.x, d.y, d.sprite, d.scale, d.flip);
+            }
+        });
+        bench.SetDrawTarget(&slow);
+        double slow_ms = Time(frames, [&]()
+        {
+            for (auto &d : draws)
+            {
+                bench.SetPixelMode(d.mode);
+                bench.ReferenceDrawPartialSprite(d.x, d.y, d.sprite, 0, 0, d.sprite->width, d.sprite->height, d.scale, d.flip);
+            }
+        });
+        bench.SetPixelMode(olc::Pixel::NORMAL);
+        same = fast.pColData == slow.pColData;
+        ok = ok && same;
+        std::printf("sprites  %zu draws:  %7.3f ms/frame, per pixel %7.3f ms/frame, %5.1fx, %s\n",
+            draws.size(), fast_ms, slow_ms, slow_ms / fast_ms, same ? "identical" : "MISMATCH");
+    }
+
+    {
+        bool same = CheckSampling();
+        ok = ok && same;
+        std::printf("batch sampling %s single samples\n", same ? "matches" : "DOES NOT MATCH");
+
+        // A spectrogram of 2048 time slices by 256 bins, zoomed into a
+        // quarter of its length and sampled onto the whole frame
+        olc::Sprite spectrum(2048, 256), frame(width, height);
+        for (int32_t y = 0; y < spectrum.height; ++y)
+            for (int32_t x = 0; x < spectrum.width; ++x)
+                spectrum.SetPixel(x, y, olc::Pixel(uint8_t(x * y), uint8_t(x + y * 3), uint8_t(y)));
+        olc::vf2d step(0.25f / width, 1.0f / height);
+        for (bool bl : { false, true })
+        {
+            double ms = Time(frames, [&]()
+            {
+                for (int32_t y = 0; y < height; ++y)
+                {
+                    olc::vf2d start(0.3f, (y + 0.5f) * step.y);
+                    if (bl) spectrum.SampleSpanBL(start, { step.x, 0.0f }, &frame.pColData[size_t(y) * width], width);
+                    else spectrum.SampleSpan(start, { step.x, 0.0f }, &frame.pColData[size_t(y) * width], width);
+                }
+            });
+            double ref_ms = Time(frames, [&]()
+            {
+                for (int32_t y = 0; y < height; ++y)
+                    for (int32_t x = 0; x < width; ++x)
+                    {
+                        olc::vf2d at(0.3f + x * step.x, (y + 0.5f) * step.y);
+                        frame.pColData[size_t(y) * width + x] = bl ? spectrum.SampleBL(at) : spectrum.Sample(at);
+                    }
+            });
+            std::printf("%-8s spectrogram: %7.3f ms/frame, per sample %7.3f ms/frame, %5.1fx\n",
+                bl ? "bilinear" : "nearest", ms, ref_ms, ref_ms / ms);
+        }
+    }
+
+    {
+        bench.CreateLayer();
+        olc::Sprite icon(16, 16);
+        for (int32_t i = 0; i < 16 * 16; ++i)
+            icon.pColData[i] = olc::Pixel(uint8_t(i), uint8_t(i * 7), 90);
+        bool same = CheckDirtyRects(bench, &icon);
+        ok = ok && same;
+
+        // A paused roll where only the playhead moves: undraw it, redraw it
+        olc::LayerDesc &layer = bench.GetLayers()[0];
+        layer.dirty.vecRects.clear();
+        bench.SetDrawTarget(nullptr);
+        bench.FillRect(400, 0, 2, height, olc::DARK_GREY);
+        bench.FillRect(404, 0, 2, height, olc::WHITE);
+        bench.DrawString(410, 4, "1:23.4", olc::WHITE);
+        int64_t area = 0;
+        for (auto &r : layer.dirty.vecRects)
+            area += int64_t(r.second.x - r.first.x) * (r.second.y - r.first.y);
+        std::printf("dirty rects %s every changed pixel, a moved playhead uploads %.1f%% of the layer\n",
+            same ? "cover" : "DO NOT COVER", 100.0 * area / (int64_t(width) * height));
+    }
+
+    // The same scene drawn directly, then through the command buffer
+    olc::Sprite icon(16, 16);
+    for (int32_t i = 0; i < 16 * 16; ++i)
+        icon.pColData[i] = (i / 16 + i % 16) % 3 ? olc::Pixel(200, 80, 40) : olc::BLANK;
+    olc::Sprite direct(3840, 2160), tiled(3840, 2160);
+    bench.SetDrawTarget(&direct);
+    double direct_ms = Time(frames, [&]() { RollScene(bench, &icon); });
+    std::printf("4K scene direct:          %8.3f ms/frame\n", direct_ms);
+    for (uint32_t threads : { 1u, 2u, 4u, 8u })
+    {
+        bench.SetDrawTarget(&tiled);
+        bench.EnableCommandBuffer(true, threads);
+        double tiled_ms = Time(frames, [&]()
+        {
+            RollScene(bench, &icon);
+            bench.FlushCommands();
+        });
+        bench.EnableCommandBuffer(false);
+        bool same = tiled.pColData == direct.pColData;
+        ok = ok && same;
+        std::printf("4K scene tiled, %u thread%s %8.3f ms/frame, %5.2fx, %s\n",
+            threads, threads > 1 ? "s:" : ": ", tiled_ms, direct_ms / tiled_ms, same ? "identical" : "MISMATCH");
+    }
+
+    {
+        Scene scene;
+        scene.Construct(160, 120, 2, 2);
+        scene.Start();
+        bool same = scene.frame.width == 320 && scene.frame.height == 240;
+        for (int32_t y = 0; same && y < scene.frame.height; ++y)
+            for (int32_t x = 0; same && x < scene.frame.width; ++x)
+                same = scene.frame.GetPixel(x, y) == scene.Expected(x / 2, y / 2);
+        ok = ok && same;
+        std::printf("headless frames %s hand-blended layers and decals\n", same ? "match" : "DO NOT MATCH");
+    }
+    {
+        Scene scene;
+        scene.frames = frames;
+        scene.Construct(1280, 720, 1, 1);
+        auto start = std::chrono::steady_clock::now();
+        scene.Start();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+        std::printf("headless 1280x720, a layer and 2000 note decals: %7.3f ms/frame\n", ms);
+    }
+    {
+        // Keys arrive from another thread, as they do on Windows
+        Pacer pacer;
+        pacer.Construct(64, 64, 1, 1);
+        std::thread press([&pacer]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            pacer.olc_UpdateKeyState(olc::Key::SPACE, true);
+        });
+        pacer.Start();
+        press.join();
+        bool within = pacer.GetFrameStats().nSkipped > 0 && pacer.pressed_elapsed >= 0.0f && pacer.pressed_elapsed <= 1.0f / 60.0f;
+        ok = ok && within;
+        std::printf("a key press after %llu idle polls %s one poll period: %.2f ms elapsed\n",
+            (unsigned long long)pacer.GetFrameStats().nSkipped, within ? "is within" : "EXCEEDS", pacer.pressed_elapsed * 1000.0f);
+    }
+
+    return ok ? 0 : 1;
+}
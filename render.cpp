@@ -0,0 +1,303 @@
+/* Offscreen batch renderer for the piano roll.
+ *
+ * Draws what olcMIDIViewer would show while playing each file, without a
+ * window or GPU, either as numbered PNG frames or as one raw RGBA stream on
+ * stdout for piping into a video encoder. Files are cut into runs of frames
+ * and the runs are shared out between threads, so both many small files and
+ * one long file keep every core busy.
+ *
+ * usage: render [options] file.mid [file.mid ...]
+ *   -o dir       directory for PNG frames, named <file>_<frame>.png (default .)
+ *   -w width     frame width (default 1280)
+ *   -h height    frame height (default 720)
+ *   -fps n       frames per second of song time (default 30)
+ *   -start s     song time of the first frame in seconds (default 0)
+ *   -frames n    frames per file, default is up to the end of the song
+ *   -j threads   worker threads (default all cores)
+ *   -tiles n     also rasterize each frame across n threads, for few large
+ *                frames (e.g. one 4K thumbnail) that -j cannot share out
+ *   -raw         write width x height x 4 byte RGBA frames to stdout, file
+ *                after file, instead of PNGs
+ *
+ * A thumbnail is a single frame: render -frames 1 -start 30 song.mid
+ * A preview video: render -raw -w 640 -h 360 song.mid |
+ *     ffmpeg -f rawvideo -pix_fmt rgba -s 640x360 -r 30 -i - preview.mp4
+ */
+#define OLC_PGE_HEADLESS
+#define OLC_PGE_APPLICATION
+
+#include "olcMIDIViewer.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+static uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t size)
+{
+    static const auto table = []()
+    {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutBE32(std::vector<uint8_t> &out, uint32_t n)
+{
+    out.insert(out.end(), { uint8_t(n >> 24), uint8_t(n >> 16), uint8_t(n >> 8), uint8_t(n) });
+}
+
+static void PutChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+    PutBE32(out, uint32_t(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    PutBE32(out, Crc32(0, &out[start], out.size() - start));
+}
+
+/* Encodes an RGBA image as a PNG. The zlib stream only uses stored blocks:
+ * frames are mostly flat colour and compress well afterwards, but the
+ * renderer should not spend its time in deflate.
+ */
+static bool WritePNG(const std::string &path, const olc::Sprite &frame)
+{
+    uint32_t w = frame.width, h = frame.height;
+    size_t row = size_t(w) * 4 + 1;
+
+    std::vector<uint8_t> raw(row * h);
+    for (uint32_t y = 0; y < h; ++y)
+    {
+        raw[y * row] = 0; // No filter
+        std::memcpy(&raw[y * row + 1], &frame.pColData[size_t(y) * w], size_t(w) * 4);
+    }
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    uint32_t a = 1, b = 0;
+    for (size_t pos = 0; pos < raw.size() || pos == 0;)
+    {
+        size_t len = std::min<size_t>(raw.size() - pos, 65535);
+        bool last = pos + len == raw.size();
+        zlib.insert(zlib.end(), { uint8_t(last), uint8_t(len), uint8_t(len >> 8), uint8_t(~len), uint8_t(~len >> 8) });
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        for (size_t i = pos; i < pos + len; ++i)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += len;
+        if (last)
+            break;
+    }
+    PutBE32(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> ihdr;
+    PutBE32(ihdr, w);
+    PutBE32(ihdr, h);
+    ihdr.insert(ihdr.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, not interlaced
+
+    std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    PutChunk(png, "IHDR", ihdr);
+    PutChunk(png, "IDAT", zlib);
+    PutChunk(png, "IEND", {});
+
+    FILE *fp = std::fopen(path.c_str(), "wb");
+    if (!fp)
+        return false;
+    bool ok = std::fwrite(png.data(), 1, png.size(), fp) == png.size();
+    return std::fclose(fp) == 0 && ok;
+}
+
+// A run of consecutive frames of one file
+struct Job
+{
+    size_t file;
+    uint32_t first, count;
+};
+
+int main(int argc, char *argv[])
+{
+    std::string outdir = ".";
+    int32_t width = 1280, height = 720;
+    double fps = 30.0, start = 0.0;
+    long frames = -1;
+    unsigned threads = std::thread::hardware_concurrency();
+    unsigned tile_threads = 1;
+    bool raw = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool value = i + 1 < argc;
+        if (arg == "-o" && value) outdir = argv[++i];
+        else if (arg == "-w" && value) width = std::atoi(argv[++i]);
+        else if (arg == "-h" && value) height = std::atoi(argv[++i]);
+        else if (arg == "-fps" && value) fps = std::atof(argv[++i]);
+        else if (arg == "-start" && value) start = std::atof(argv[++i]);
+        else if (arg == "-frames" && value) frames = std::atol(argv[++i]);
+        else if (arg == "-j" && value) threads = std::atoi(argv[++i]);
+        else if (arg == "-tiles" && value) tile_threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-raw") raw = true;
+        else if (arg[0] == '-')
+        {
+            std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+        else files.push_back(arg);
+    }
+    if (files.empty() || width <= 0 || height <= 0 || fps <= 0.0)
+    {
+        std::fprintf(stderr, "usage: render [-o dir] [-w width] [-h height] [-fps n] [-start s] [-frames n] [-j threads] [-tiles n] [-raw] file.mid ...\n");
+        return 2;
+    }
+    threads = std::max(1u, threads);
+
+#if defined(_WIN32)
+    if (raw)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    // The engine keeps its platform and renderer in globals that each
+    // constructor replaces, so every viewer is made here before any thread
+    // starts. Workers draw straight into sprites and never use the renderer,
+    // which headless only holds the textures made here.
+    std::vector<std::unique_ptr<olcMIDIViewer>> viewers;
+    for (unsigned i = 0; i < threads; ++i)
+    {
+        viewers.push_back(std::make_unique<olcMIDIViewer>());
+        viewers.back()->Construct(width, height, 1, 1);
+        viewers.back()->olc_ConstructFontSheet();
+        if (tile_threads > 1)
+            viewers.back()->EnableCommandBuffer(true, tile_threads);
+    }
+
+    auto RunWorkers = [&](auto &&Worker)
+    {
+        std::vector<std::thread> workers;
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back(Worker, i);
+        Worker(0);
+        for (auto &worker : workers)
+            worker.join();
+    };
+
+    // Parse every file once up front to learn how many frames it needs
+    std::vector<uint32_t> counts(files.size());
+    std::atomic<size_t> next{0};
+    std::atomic<unsigned> failed{0};
+    RunWorkers([&](unsigned)
+    {
+        for (size_t i = next++; i < files.size(); i = next++)
+        {
+            MidiFile midi;
+            midi.bVerbose = false;
+            if (!midi.ParseFile(files[i]))
+            {
+                std::fprintf(stderr, "%s: could not parse\n", files[i].c_str());
+                failed++;
+                continue;
+            }
+            double seconds = std::max(0.0, midi.Duration() - start);
+            counts[i] = frames >= 0 ? uint32_t(frames) : uint32_t(std::ceil(seconds * fps));
+        }
+    });
+
+    // Short runs keep the reorder window small when streaming, long runs
+    // let each worker reuse its cached tiles while the roll scrolls
+    uint32_t run = raw ? 8 : 64;
+    std::vector<Job> jobs;
+    for (size_t i = 0; i < files.size(); ++i)
+        for (uint32_t f = 0; f < counts[i]; f += run)
+            jobs.push_back({ i, f, std::min(run, counts[i] - f) });
+
+    // Streamed runs are written strictly in job order
+    std::mutex mux;
+    std::condition_variable written;
+    size_t next_write = 0;
+    std::atomic<uint64_t> rendered{0};
+
+    auto begin = std::chrono::steady_clock::now();
+    next = 0;
+    RunWorkers([&](unsigned id)
+    {
+        olcMIDIViewer &viewer = *viewers[id];
+        size_t loaded = SIZE_MAX;
+        size_t frame_bytes = size_t(width) * height * 4;
+        std::vector<uint8_t> buffer;
+        olc::Sprite frame(width, height);
+
+        for (size_t j = next++; j < jobs.size(); j = next++)
+        {
+            const Job &job = jobs[j];
+            if (loaded != job.file)
+            {
+                viewer.Load(files[job.file]);
+                loaded = job.file;
+            }
+
+            std::string stem = std::filesystem::path(files[job.file]).stem().string();
+            buffer.resize(raw ? frame_bytes * job.count : 0);
+            for (uint32_t f = job.first; f < job.first + job.count; ++f)
+            {
+                viewer.RenderFrame(start + f / fps, &frame);
+                if (raw)
+                {
+                    std::memcpy(&buffer[frame_bytes * (f - job.first)], frame.pColData.data(), frame_bytes);
+                    continue;
+                }
+                char name[32];
+                std::snprintf(name, sizeof(name), "_%06u.png", f);
+                std::string path = (std::filesystem::path(outdir) / (stem + name)).string();
+                if (!WritePNG(path, frame))
+                {
+                    std::fprintf(stderr, "%s: could not write\n", path.c_str());
+                    failed++;
+                }
+            }
+            rendered += job.count;
+
+            if (raw)
+            {
+                std::unique_lock<std::mutex> lock(mux);
+                written.wait(lock, [&]() { return next_write == j; });
+                if (std::fwrite(buffer.data(), 1, buffer.size(), stdout) != buffer.size())
+                    failed++;
+                next_write++;
+                written.notify_all();
+            }
+        }
+    });
+    std::fflush(stdout);
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::fprintf(stderr, "%llu frames from %zu files in %.2fs (%.1f frames/s) on %u threads\n",
+        (unsigned long long)rendered, files.size(), wall, rendered / std::max(wall, 1e-9), threads);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/* Round-trip check between the MIDI writer and the MIDI parser.
+ *
+ * Random multi-track songs are encoded with MIDIfile, parsed back with
+ * MidiFile, and every track's notes are compared against what was written.
+ * Songs are spread over all cores, and the time spent in each direction is
+ * reported as a throughput figure.
+ *
+ * usage: roundtrip [songs] [notes per song] [threads]
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include "MidiWriter.h"
+#include "MidiFile.h"
+
+struct Song
+{
+    std::vector<std::vector<MidiNote>> tracks;
+};
+
+// Notes never overlap another note of the same key on the same track, so the
+// parser can only ever pair each key-off with the note it belongs to.
+static Song RandomSong(uint32_t seed, unsigned notes)
+{
+    auto Random = [&seed]()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    Song song;
+    song.tracks.resize(1 + Random() % 8);
+    for (unsigned t = 0; t < song.tracks.size(); ++t)
+    {
+        auto &track = song.tracks[t];
+        uint32_t free_at[128] = {};
+        uint32_t time = 0;
+        for (unsigned n = t; n < notes; n += song.tracks.size())
+        {
+            MidiNote note;
+            note.nKey = 24 + Random() % 84;
+            note.nVelocity = 1 + Random() % 127;
+            note.nChannel = t % 16;
+            time += Random() % 4 == 0 ? Random() % 2000 : 0;
+            note.nStartTime = std::max(time, free_at[note.nKey]);
+            note.nDuration = 1 + Random() % 4000;
+            free_at[note.nKey] = note.nStartTime + note.nDuration;
+            track.push_back(note);
+        }
+    }
+    return song;
+}
+
+static std::string Encode(const Song &song)
+{
+    MIDIfile file;
+    for (unsigned t = 0; t < song.tracks.size(); ++t)
+    {
+        MIDIscheduler scheduler;
+        for (auto &note : song.tracks[t])
+            scheduler.Note(note.nStartTime, note.nDuration, note.nChannel, note.nKey, note.nVelocity);
+        scheduler.Drain(file[t]);
+    }
+    file.Finish();
+
+    std::ostringstream os(std::ios::binary);
+    file.Write(os);
+    return os.str();
+}
+
+static bool SameNotes(std::vector<MidiNote> a, std::vector<MidiNote> b)
+{
+    auto Earlier = [](const MidiNote &x, const MidiNote &y)
+    {
+        return x.nStartTime != y.nStartTime ? x.nStartTime < y.nStartTime : x.nKey < y.nKey;
+    };
+    std::sort(a.begin(), a.end(), Earlier);
+    std::sort(b.begin(), b.end(), Earlier);
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const MidiNote &x, const MidiNote &y)
+    {
+        return x.nKey == y.nKey && x.nVelocity == y.nVelocity && x.nChannel == y.nChannel && x.nStartTime == y.nStartTime && x.nDuration == y.nDuration;
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned songs = argc > 1 ? std::atoi(argv[1]) : 256;
+    unsigned notes = argc > 2 ? std::atoi(argv[2]) : 8192;
+    unsigned threads = argc > 3 ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+    threads = std::max(1u, threads);
+
+    std::atomic<unsigned> next{0}, failed{0};
+    std::atomic<uint64_t> total_notes{0}, total_bytes{0}, write_ns{0}, parse_ns{0};
+
+    auto Worker = [&]()
+    {
+        using clock = std::chrono::steady_clock;
+        for (unsigned i = next++; i < songs; i = next++)
+        {
+            Song song = RandomSong(0x9E3779B9u * (i + 1), notes);
+
+            auto t0 = clock::now();
+            std::string bytes = Encode(song);
+            auto t1 = clock::now();
+            MidiFile midi;
+            midi.bVerbose = false;
+            std::istringstream is(bytes, std::ios::binary);
+            bool ok = midi.Parse(is);
+            auto t2 = clock::now();
+
+            ok = ok && midi.vecTracks.size() == song.tracks.size();
+            for (unsigned t = 0; ok && t < song.tracks.size(); ++t)
+                ok = SameNotes(song.tracks[t], midi.vecTracks[t].vecNotes);
+            if (!ok)
+            {
+                failed++;
+                std::fprintf(stderr, "song %u: round trip mismatch\n", i);
+            }
+
+            total_notes += notes;
+            total_bytes += bytes.size();
+            write_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            parse_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; ++i)
+        workers.emplace_back(Worker);
+    Worker();
+    for (auto &worker : workers)
+        worker.join();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Per-direction rates are per thread, the overall rate is wall clock
+    double notes_total = double(total_notes);
+    std::printf("%u songs, %.0f notes, %.1f MB on %u threads\n", songs, notes_total, total_bytes / 1e6, threads);
+    std::printf("write: %.2f Mnotes/s per thread\n", notes_total / (write_ns / 1e9) / 1e6);
+    std::printf("parse: %.2f Mnotes/s per thread\n", notes_total / (parse_ns / 1e9) / 1e6);
+    std::printf("round trip: %.2f Mnotes/s overall (%.2fs)\n", notes_total / wall / 1e6, wall);
+    std::printf("%u mismatched songs\n", unsigned(failed));
+
+    return failed ? 1 : 0;
+}